@@ -4,6 +4,10 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#ifndef _WIN32
+    #include <sys/resource.h>
+    #include <time.h>
+#endif
 
 #define CMD_CC_32BIT(cmd) cmd_append((cmd), "i686-w64-mingw32-gcc")
 #define CMD_CC_64BIT(cmd) cmd_append((cmd), "x86_64-w64-mingw32-gcc")
@@ -12,20 +16,304 @@
 #elif INTPTR_MAX == INT32_MAX
     #define IS_64BIT false
 #endif
-#define CMD_CFLAGS(cmd) cmd_append((cmd), "-Wall", "-Wextra", "-Wswitch-enum", "-static", "-isystem:./winver.h")
+#define CMD_CFLAGS(cmd) cmd_append((cmd), "-Wall", "-Wextra", "-Wswitch-enum", "-O2", "-static", "-isystem:./winver.h")
 #define CMD_FILE(cmd, name) cmd_append((cmd), "-o", temp_sprintf("./build/%s", (name)), temp_sprintf("./src/%s.c", (name)))
+// Tools that don't need Windows are also built for the host, so they can run offline
+#define CMD_CC_NATIVE(cmd) cmd_append((cmd), "cc")
+#define CMD_CFLAGS_NATIVE(cmd) cmd_append((cmd), "-Wall", "-Wextra", "-Wswitch-enum", "-O2", "-pthread")
+#define CMD_FILE_NATIVE(cmd, name) cmd_append((cmd), "-o", temp_sprintf("./build/native/%s", (name)), temp_sprintf("./src/%s.c", (name)))
+
+typedef struct {
+    const char* name;
+    // Whether the tool also works without Windows
+    bool portable;
+} File;
 
-const char* files[] = {
-    "changefont",
+const File files[] = {
+    {"changefont", false},
+    {"regdiff", true},
+    {"reglz", true},
+    {"reghive", true},
+    {"regfleet", true},
 };
 
+// Tests in ./tests, which are built and run for the host after the portable tools
+const char* tests[] = {"pool", "log", "regdiff"};
+#define TESTS_DIR "./build/tests"
+
+// Directory in which the end-to-end harness keeps its Wine prefix, seed and results
+#define E2E_DIR "./build/e2e"
+
+// Options for the end-to-end harness
+typedef struct {
+    size_t fonts;
+    size_t substitutes;
+    size_t links;
+    // Let changefont write the changes to the registry of the prefix
+    bool apply;
+} E2E_Options;
+
 void log_usage(Log_Level level, const char* program) {
-    nob_log(level, "Usage: %s [options]");
+    nob_log(level, "Usage: %s [command] [options]", program);
 }
 
 void log_options(Log_Level level) {
+    nob_log(level, "Available commands:");
+    nob_log(level, "  e2e               Build, then run changefont under Wine against a seeded registry");
+    nob_log(level, "  test              Build, then run the tests of nob.h and regdiff");
+    nob_log(level, "  bench             Build, then measure how the thread pool of nob.h scales with the processors");
     nob_log(level, "Available options:");
     nob_log(level, "  --bitness 32|64   Sets the target bitness");
+    nob_log(level, "  --fonts N         Amount of fonts in the e2e seed (default: 1000)");
+    nob_log(level, "  --substitutes N   Amount of font substitutes in the e2e seed (default: 100)");
+    nob_log(level, "  --links N         Amount of SystemLink entries in the e2e seed (default: 20)");
+    nob_log(level, "  --apply           Run changefont with --apply in the e2e prefix");
+    nob_log(level, "  --tsan            Build the tests with ThreadSanitizer");
+    nob_log(level, "  --threads N       Most threads that bench measures (default: amount of processors)");
+}
+
+// Parse a count option value
+// Returns true on success, false on failure
+bool parse_count(const char* value, size_t* result) {
+    char* end = NULL;
+    unsigned long long count = strtoull(value, &end, 10);
+    if (end == value || *end != '\0') return false;
+    *result = (size_t) count;
+    return true;
+}
+
+#ifndef _WIN32
+// A single measured step of the end-to-end harness
+typedef struct {
+    const char* name;
+    double wall_ms;
+    // Peak resident set size of the measured process, in KiB
+    long peak_rss_kb;
+} E2E_Phase;
+
+typedef struct {
+    E2E_Phase* items;
+    size_t count;
+    size_t capacity;
+} E2E_Phases;
+
+double e2e_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// Run a command, recording its wall time and peak resident set size as a phase
+// Resets the command and closes the redirected files
+// Returns true on success, false on failure
+bool e2e_run_phase(E2E_Phases* phases, const char* name, Cmd* cmd, Cmd_Redirect redirect) {
+    double start = e2e_now_ms();
+    Proc proc = cmd_run_async_redirect_and_reset(cmd, redirect);
+    if (proc == INVALID_PROC) return false;
+
+    int wstatus = 0;
+    struct rusage usage = {0};
+    if (wait4(proc, &wstatus, 0, &usage) < 0) {
+        nob_log(ERROR, "Could not wait on %s (pid %d): %s", name, proc, strerror(errno));
+        return false;
+    }
+    E2E_Phase phase = {
+        .name = name,
+        .wall_ms = e2e_now_ms() - start,
+        .peak_rss_kb = usage.ru_maxrss,
+    };
+    da_append(phases, phase);
+
+    if (!WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0) {
+        nob_log(ERROR, "Phase %s failed", name);
+        return false;
+    }
+    return true;
+}
+
+// Append a REG_MULTI_SZ value containing a single string to a .reg file
+void e2e_sb_append_multi_sz(String_Builder* sb, const char* string) {
+    sb_append_cstr(sb, "hex(7):");
+    size_t len = strlen(string);
+    // REG_MULTI_SZ is stored as UTF-16LE, terminated by two NUL characters
+    for (size_t i = 0; i < len; ++i) {
+        sb_append_cstr(sb, temp_sprintf("%02x,00,", (unsigned char) string[i]));
+    }
+    sb_append_cstr(sb, "00,00,00,00");
+}
+
+// Generate a .reg file with the requested amount of fonts, substitutes and links
+String_Builder e2e_generate_seed(E2E_Options options) {
+    String_Builder sb = {0};
+    sb_append_cstr(&sb, "Windows Registry Editor Version 5.00\n");
+
+    sb_append_cstr(&sb, "\n[HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts]\n");
+    for (size_t i = 0; i < options.fonts; ++i) {
+        sb_append_cstr(&sb, temp_sprintf("\"E2E Font %zu (TrueType)\"=\"e2efont%zu.ttf\"\n", i, i));
+    }
+
+    sb_append_cstr(&sb, "\n[HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontSubstitutes]\n");
+    for (size_t i = 0; i < options.substitutes; ++i) {
+        sb_append_cstr(&sb, temp_sprintf("\"E2E Substitute %zu\"=\"E2E Font %zu\"\n", i, options.fonts > 0 ? i % options.fonts : 0));
+    }
+
+    sb_append_cstr(&sb, "\n[HKEY_LOCAL_MACHINE\\SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontLink\\SystemLink]\n");
+    for (size_t i = 0; i < options.links; ++i) {
+        sb_append_cstr(&sb, temp_sprintf("\"E2E Font %zu\"=", i));
+        e2e_sb_append_multi_sz(&sb, temp_sprintf("e2efont%zu.ttf,E2E Font %zu", i + 1, i + 1));
+        sb_append_cstr(&sb, "\n");
+    }
+
+    temp_reset();
+    return sb;
+}
+
+// Print the phases as a table and write them, along with the --stats-json output of changefont, to a JSON file
+// Returns true on success, false on failure
+bool e2e_report(E2E_Options options, const E2E_Phases phases, const char* stats_path, const char* json_path) {
+    printf("\n");
+    printf("%-24s %12s %14s\n", "Phase", "Wall (ms)", "Peak RSS (KiB)");
+    for (size_t i = 0; i < phases.count; ++i) {
+        printf("%-24s %12.2f %14ld\n", phases.items[i].name, phases.items[i].wall_ms, phases.items[i].peak_rss_kb);
+    }
+    printf("\n");
+
+    String_Builder json = {0};
+    sb_append_cstr(&json, temp_sprintf("{\"fonts\":%zu,\"substitutes\":%zu,\"links\":%zu,\"apply\":%s,\"phases\":[",
+        options.fonts, options.substitutes, options.links, options.apply ? "true" : "false"));
+    for (size_t i = 0; i < phases.count; ++i) {
+        if (i > 0) da_append(&json, ',');
+        sb_append_cstr(&json, temp_sprintf("{\"name\":\"%s\",\"wall_ms\":%.3f,\"peak_rss_kb\":%ld}",
+            phases.items[i].name, phases.items[i].wall_ms, phases.items[i].peak_rss_kb));
+    }
+    sb_append_cstr(&json, "],\"changefont\":");
+    temp_reset();
+    String_Builder stats = {0};
+    if (!read_entire_file(stats_path, &stats)) {
+        sb_free(json);
+        return false;
+    }
+    // Strip the trailing newline of the embedded JSON
+    while (stats.count > 0 && isspace(stats.items[stats.count - 1])) --stats.count;
+    sb_append_buf(&json, stats.items, stats.count);
+    sb_free(stats);
+    sb_append_cstr(&json, "}\n");
+
+    bool result = write_entire_file(json_path, json.items, json.count);
+    if (result) nob_log(INFO, "Wrote e2e results to %s", json_path);
+    sb_free(json);
+    return result;
+}
+#endif // _WIN32
+
+// Run the cross-compiled changefont in a throwaway Wine prefix with a seeded registry
+// Returns true on success, false on failure
+bool run_e2e(E2E_Options options) {
+#ifdef _WIN32
+    UNUSED(options);
+    nob_log(ERROR, "The e2e command runs changefont under Wine and is not available on Windows");
+    return false;
+#else
+    bool result = true;
+    Cmd cmd = {0};
+    E2E_Phases phases = {0};
+    String_Builder seed = {0};
+
+    const char* seed_path = E2E_DIR"/seed.reg";
+    const char* answers_path = E2E_DIR"/answers.txt";
+    const char* exe_path = E2E_DIR"/changefont.exe";
+    const char* stats_path = E2E_DIR"/stats.json";
+
+    // Start from a clean slate, so nothing from a previous run can leak into the measurements
+    cmd_append(&cmd, "rm", "-rf", E2E_DIR);
+    if (!cmd_run_sync_and_reset(&cmd)) return_defer(false);
+    if (!mkdir_if_not_exists(E2E_DIR)) return_defer(false);
+
+    // Point every Wine invocation at the throwaway prefix, and keep Wine quiet
+    char* prefix_abs = realpath(E2E_DIR, NULL);
+    if (prefix_abs == NULL) {
+        nob_log(ERROR, "Could not resolve %s: %s", E2E_DIR, strerror(errno));
+        return_defer(false);
+    }
+    setenv("WINEPREFIX", temp_sprintf("%s/prefix", prefix_abs), 1);
+    free(prefix_abs);
+    setenv("WINEDEBUG", "-all", 1);
+    // Don't ask to install Mono and Gecko when creating the prefix
+    setenv("WINEDLLOVERRIDES", "mscoree,mshtml=", 1);
+
+    seed = e2e_generate_seed(options);
+    if (!write_entire_file(seed_path, seed.items, seed.count)) return_defer(false);
+    // Pick the first font that matches the query and confirm
+    const char* answers = "E2E Font\n0\ny\n";
+    if (!write_entire_file(answers_path, answers, strlen(answers))) return_defer(false);
+    // The output files are written next to the executable, so keep them inside the e2e directory
+    if (!copy_file("./build/changefont.exe", exe_path)) return_defer(false);
+
+    cmd_append(&cmd, "wine", "wineboot", "--init");
+    if (!e2e_run_phase(&phases, "prefix creation", &cmd, (Cmd_Redirect) {0})) return_defer(false);
+
+    cmd_append(&cmd, "wine", "regedit", "/S", seed_path);
+    if (!e2e_run_phase(&phases, "seed import", &cmd, (Cmd_Redirect) {0})) return_defer(false);
+
+    Fd fdin = fd_open_for_read(answers_path);
+    if (fdin == INVALID_FD) return_defer(false);
+    cmd_append(&cmd, "wine", exe_path, "--stats", "--stats-json", stats_path);
+    if (options.apply) cmd_append(&cmd, "--apply");
+    if (!e2e_run_phase(&phases, "changefont", &cmd, (Cmd_Redirect) {.fdin = &fdin})) return_defer(false);
+
+    if (!file_exists(E2E_DIR"/backup_fonts.reg")) {
+        nob_log(ERROR, "changefont didn't write a backup file");
+        return_defer(false);
+    }
+
+    if (!e2e_report(options, phases, stats_path, E2E_DIR"/results.json")) return_defer(false);
+
+defer:
+    // Shut down the wineserver of the throwaway prefix
+    cmd_append(&cmd, "wineserver", "-k");
+    cmd_run_sync_and_reset(&cmd);
+    cmd_free(cmd);
+    da_free(phases);
+    sb_free(seed);
+    return result;
+#endif // _WIN32
+}
+
+// Build the tests for the host and run them, or only the benchmark of the thread pool if bench is set
+// The benchmark goes up to bench_threads threads, or the amount of processors if it is 0
+// Returns true on success, false on failure
+bool run_tests(bool bench, size_t bench_threads, bool tsan) {
+#ifdef _WIN32
+    UNUSED(bench);
+    UNUSED(bench_threads);
+    UNUSED(tsan);
+    nob_log(ERROR, "The tests are built with the compiler of the host and are not available on Windows");
+    return false;
+#else
+    bool result = true;
+    Cmd cmd = {0};
+    if (!mkdir_if_not_exists(TESTS_DIR)) return false;
+
+    for (size_t i = 0; i < ARRAY_LEN(tests); ++i) {
+        if (bench && strcmp(tests[i], "pool") != 0) continue;
+        const char* exe_path = temp_sprintf(TESTS_DIR"/%s", tests[i]);
+        CMD_CC_NATIVE(&cmd);
+        CMD_CFLAGS_NATIVE(&cmd);
+        if (tsan) cmd_append(&cmd, "-g", "-fsanitize=thread");
+        cmd_append(&cmd, "-o", exe_path, temp_sprintf("./tests/%s.c", tests[i]));
+        if (!cmd_run_sync_and_reset(&cmd)) return_defer(false);
+
+        cmd_append(&cmd, exe_path);
+        if (bench) cmd_append(&cmd, "bench");
+        if (bench && bench_threads > 0) cmd_append(&cmd, temp_sprintf("%zu", bench_threads));
+        if (!cmd_run_sync_and_reset(&cmd)) return_defer(false);
+        temp_reset();
+    }
+
+defer:
+    cmd_free(cmd);
+    return result;
+#endif // _WIN32
 }
 
 int main(int argc, char** argv) {
@@ -34,6 +322,27 @@ int main(int argc, char** argv) {
     const char* program = shift(argv, argc);
 
     bool target_64bit = IS_64BIT;
+    bool e2e = false;
+    bool test = false;
+    bool bench = false;
+    bool tsan = false;
+    size_t bench_threads = 0;
+    E2E_Options e2e_options = {
+        .fonts = 1000,
+        .substitutes = 100,
+        .links = 20,
+    };
+    // Parse the command
+    if (argc > 0 && strcmp(argv[0], "e2e") == 0) {
+        shift(argv, argc);
+        e2e = true;
+    } else if (argc > 0 && strcmp(argv[0], "test") == 0) {
+        shift(argv, argc);
+        test = true;
+    } else if (argc > 0 && strcmp(argv[0], "bench") == 0) {
+        shift(argv, argc);
+        bench = true;
+    }
     // Parse the options
     while (argc > 0) {
         const char* option = shift(argv, argc);
@@ -54,6 +363,36 @@ int main(int argc, char** argv) {
                 nob_log(ERROR, "Invalid bitness value");
                 return 1;
             }
+        } else if (strcmp(option, "--fonts") == 0 || strcmp(option, "--substitutes") == 0 || strcmp(option, "--links") == 0) {
+            if (argc < 1) {
+                log_usage(ERROR, program);
+                nob_log(ERROR, "Missing %s value", option);
+                return 1;
+            }
+
+            size_t* count = strcmp(option, "--fonts") == 0 ? &e2e_options.fonts
+                          : strcmp(option, "--substitutes") == 0 ? &e2e_options.substitutes
+                          : &e2e_options.links;
+            if (!parse_count(shift(argv, argc), count)) {
+                log_usage(ERROR, program);
+                nob_log(ERROR, "Invalid %s value", option);
+                return 1;
+            }
+        } else if (strcmp(option, "--apply") == 0) {
+            e2e_options.apply = true;
+        } else if (strcmp(option, "--tsan") == 0) {
+            tsan = true;
+        } else if (strcmp(option, "--threads") == 0) {
+            if (argc < 1) {
+                log_usage(ERROR, program);
+                nob_log(ERROR, "Missing %s value", option);
+                return 1;
+            }
+            if (!parse_count(shift(argv, argc), &bench_threads) || bench_threads == 0) {
+                log_usage(ERROR, program);
+                nob_log(ERROR, "Invalid %s value", option);
+                return 1;
+            }
         } else if (strcmp(option, "--help") == 0) {
             log_usage(INFO, program);
             log_options(INFO);
@@ -74,10 +413,25 @@ int main(int argc, char** argv) {
         if (target_64bit) CMD_CC_64BIT(&cmd);
         else              CMD_CC_32BIT(&cmd);
         CMD_CFLAGS(&cmd);
-        CMD_FILE(&cmd, files[i]);
+        CMD_FILE(&cmd, files[i].name);
+        if (!cmd_run_sync_and_reset(&cmd)) return 1;
+        temp_reset();
+    }
+
+#ifndef _WIN32
+    mkdir_if_not_exists("./build/native");
+    for (size_t i = 0; i < ARRAY_LEN(files); ++i) {
+        if (!files[i].portable) continue;
+        CMD_CC_NATIVE(&cmd);
+        CMD_CFLAGS_NATIVE(&cmd);
+        CMD_FILE_NATIVE(&cmd, files[i].name);
         if (!cmd_run_sync_and_reset(&cmd)) return 1;
         temp_reset();
     }
+#endif // _WIN32
+
+    if (e2e && !run_e2e(e2e_options)) return 1;
+    if ((test || bench) && !run_tests(bench, bench_threads, tsan)) return 1;
 
     return 0;
 }
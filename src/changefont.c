@@ -1,3 +1,8 @@
+#include <stddef.h>
+// Route the allocations of nob.h through the allocation counters of --stats
+void* stats_realloc(void* ptr, size_t size);
+#define NOB_REALLOC stats_realloc
+
 #define NOB_IMPLEMENTATION
 #define NOB_STRIP_PREFIX
 #include "nob.h"
@@ -12,164 +17,256 @@
 #include <string.h>
 #include <windows.h>
 
-#define MAX_KEY_LENGTH 255
-#define MAX_VALUE_NAME 16383
-#define MAX_VALUE_DATA 16383
-
-// Escape a string and add it to a string builder
-void sb_append_escaped(String_Builder* sb, const char* string) {
-    size_t string_len = strlen(string);
-    // Loop through all characters in the string
-    for (size_t i = 0; i < string_len; ++i) {
-        char chr = string[i];
-        switch (chr) {
-        // If this character is a `\` or `\n`, add an escaped character to the string builder
-        case '\\':
-            sb_append_cstr(sb, "\\\\");
-            break;
-        case '\n':
-            sb_append_cstr(sb, "\\n");
-            break;
-        default:
-            // Otherwise, add the unmodified character
-            da_append(sb, chr);
-            break;
-        }
-    }
-}
+// Record the registry calls of registry.h in the --trace output
+void trace_event(const char* name, char type, long long arg);
+#define REG_TRACE_EVENT(name, type, arg) trace_event((name), (type), (arg))
 
-// Possible types for Registry_Value
-typedef enum {
-    REG_TYPE_STRING,
-    REG_TYPE_HEX,
-    REG_TYPE_DELETE,
-} Registry_Value_Type;
+#define REGISTRY_IMPLEMENTATION
+#include "registry.h"
+#define FONTS_IMPLEMENTATION
+#include "fonts.h"
 
-// Structure that stores a Windows registry value
-typedef struct {
-    char* name;
-    size_t name_len;
-    Registry_Value_Type type;
-    DWORD type_hex_type;
-    char* data;
-    size_t data_len;
-} Registry_Value;
-
-// List of registry values
+// A single begin or end event of the Chrome trace-event format
 typedef struct {
-    Registry_Value* items;
+    // Must be a string literal, because it is only formatted when the trace is written
+    const char* name;
+    // 'B' for begin events, 'E' for end events
+    char type;
+    // Time of the event, in QueryPerformanceCounter ticks
+    LONGLONG timestamp;
+    // Extra number shown in the event details, or -1 if there is none
+    long long arg;
+} Trace_Event;
+
+#define TRACE_RING_CAPACITY 8192
+
+// Ring buffer of trace events that is only ever written to by a single thread
+// If more than TRACE_RING_CAPACITY events are recorded, the oldest ones are overwritten
+typedef struct Trace_Ring {
+    Trace_Event events[TRACE_RING_CAPACITY];
+    // Total amount of events recorded, including overwritten ones
     size_t count;
-    size_t capacity;
-} Registry_Value_List;
+    DWORD thread_id;
+    struct Trace_Ring* next;
+} Trace_Ring;
 
-// Get all of the values for the HKEY parent_key, and add them to the Registry_Value_List result
-// Returns true on success, false on failure
-bool reg_key_list_values(HKEY parent_key, Registry_Value_List* result) {
-    char value_name[MAX_VALUE_NAME];
-    unsigned char value_data[MAX_VALUE_DATA+1];
-    DWORD amount_of_values = 0;
+bool trace_enabled = false;
+// List of the rings of all threads that recorded events
+Trace_Ring* volatile trace_rings = NULL;
+// Ring of the current thread, created on its first event
+_Thread_local Trace_Ring* trace_ring = NULL;
 
-    // Query the amount of values
-    int code = RegQueryInfoKeyA(parent_key, NULL, NULL, NULL, NULL /*Amount of subkeys*/, NULL, NULL, &amount_of_values, NULL, NULL, NULL, NULL);
-    if (code != ERROR_SUCCESS) {
-        nob_log(NOB_ERROR, "Couldn't query registry key info: %ld", GetLastError());
-        return false;
+// Record a trace event on the ring of the current thread
+void trace_event(const char* name, char type, long long arg) {
+    if (!trace_enabled) return;
+
+    if (trace_ring == NULL) {
+        // Allocated with calloc directly, so tracing doesn't show up in the --stats allocations
+        trace_ring = calloc(1, sizeof(*trace_ring));
+        assert(trace_ring != NULL && "Buy more RAM lol");
+        trace_ring->thread_id = GetCurrentThreadId();
+        // Register the ring without taking a lock
+        Trace_Ring* head;
+        do {
+            head = trace_rings;
+            trace_ring->next = head;
+        } while (InterlockedCompareExchangePointer((PVOID volatile*) &trace_rings, trace_ring, head) != head);
     }
 
-    // Add all of the values to the list
-    for (DWORD i = 0; i < amount_of_values; ++i) {
-        Registry_Value key = {0};
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    trace_ring->events[trace_ring->count % TRACE_RING_CAPACITY] = (Trace_Event) {
+        .name = name,
+        .type = type,
+        .timestamp = now.QuadPart,
+        .arg = arg,
+    };
+    trace_ring->count += 1;
+}
 
-        DWORD value_len = MAX_VALUE_NAME;
-        DWORD value_type;
-        DWORD data_len = MAX_VALUE_DATA;
-        // Retrieve the name and data of this value
-        code = RegEnumValueA(parent_key, i, value_name, &value_len, NULL, &value_type, value_data, &data_len);
-        if (code != ERROR_SUCCESS) {
-            nob_log(NOB_ERROR, "Couldn't enumerate value %ld of %ld: %ld", i, amount_of_values, code);
-            return false;
-        }
-        // Copy the name to the registry value
-        key.name_len = value_len;
-        key.name = malloc(sizeof(*value_name) * (value_len + 1));
-        memcpy(key.name, value_name, sizeof(*value_name) * value_len);
-        // Ensure the name is null-terminated
-        key.name[value_len] = 0;
-
-        // Copy the data to the registry value
-        key.data_len = data_len;
-        key.data = malloc(sizeof(*value_data) * (data_len + 1));
-        memcpy(key.data, value_data, sizeof(*value_data) * data_len);
-        // Ensure the data is null-terminated
-        key.data[data_len] = 0;
-
-        // Assign the correct type
-        if (value_type == REG_SZ) {
-            key.type = REG_TYPE_STRING;
-        } else {
-            key.type = REG_TYPE_HEX;
-            key.type_hex_type = value_type;
-        }
+#define trace_begin(name) trace_event((name), 'B', -1)
+#define trace_end(name) trace_event((name), 'E', -1)
 
-        // Add the registry value to the list
-        da_append(result, key);
+// Write the recorded events of all threads to a file in the Chrome trace-event format
+// Must only be called once all other threads have stopped recording events
+// Returns true on success, false on failure
+bool trace_write_json(const char* path) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    DWORD pid = GetCurrentProcessId();
+
+    String_Builder json = {0};
+    sb_append_cstr(&json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    bool first = true;
+    for (Trace_Ring* ring = trace_rings; ring != NULL; ring = ring->next) {
+        // Skip the events that have been overwritten
+        size_t start = ring->count > TRACE_RING_CAPACITY ? ring->count - TRACE_RING_CAPACITY : 0;
+        for (size_t i = start; i < ring->count; ++i) {
+            const Trace_Event* event = &ring->events[i % TRACE_RING_CAPACITY];
+            if (!first) da_append(&json, ',');
+            first = false;
+            double timestamp_us = (double) event->timestamp * 1000000.0 / (double) frequency.QuadPart;
+            temp_scope() {
+                sb_append_cstr(&json, temp_sprintf("\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":%lu,\"tid\":%lu,\"ts\":%.3f",
+                    event->name, event->type, pid, ring->thread_id, timestamp_us));
+                if (event->arg >= 0) sb_append_cstr(&json, temp_sprintf(",\"args\":{\"n\":%lld}", event->arg));
+            }
+            da_append(&json, '}');
+        }
     }
+    sb_append_cstr(&json, "\n]}\n");
 
-    return true;
+    bool result = write_entire_file(path, json.items, json.count);
+    if (result) nob_log(NOB_INFO, "Wrote trace to %s", path);
+    sb_free(json);
+    return result;
 }
 
-// Add a registry hex value to a string builder
-// Returns true on success, false on failure
-void reg_sb_append_hex(String_Builder* sb, const Registry_Value* value) {
-    assert(value->type == REG_TYPE_HEX);
+// Phases of the program that are measured for --stats
+typedef enum {
+    // Everything that doesn't belong to any of the other phases
+    PHASE_OTHER,
+    PHASE_REGISTRY_OPEN,
+    PHASE_ENUMERATE_FONTS,
+    PHASE_ENUMERATE_FONT_LINKS,
+    PHASE_ENUMERATE_FONT_SUBSTITUTES,
+    PHASE_SEARCH,
+    PHASE_SUBSTITUTE_CONSTRUCTION,
+    PHASE_BACKUP_SERIALIZATION,
+    PHASE_OUTPUT_SERIALIZATION,
+    PHASE_FILE_WRITES,
+    PHASE_CACHE,
+    PHASE_DIFF,
+    PHASE_RECOVERY,
+    PHASE_RESTORE_READ,
+    PHASE_RESTORE_ENUMERATE,
+    PHASE_JOURNAL,
+    PHASE_APPLY,
+    PHASE_VERIFY,
+    PHASE_COUNT,
+} Phase;
+
+// Measurements of a single phase
+typedef struct {
+    const char* name;
+    // Time spent in the phase, in QueryPerformanceCounter ticks
+    LONGLONG ticks;
+    size_t allocations;
+    size_t bytes;
+} Phase_Stats;
+
+Phase_Stats phase_stats[PHASE_COUNT] = {
+    [PHASE_OTHER]                      = {.name = "other"},
+    [PHASE_REGISTRY_OPEN]              = {.name = "registry open"},
+    [PHASE_ENUMERATE_FONTS]            = {.name = "enumerate fonts"},
+    [PHASE_ENUMERATE_FONT_LINKS]       = {.name = "enumerate font links"},
+    [PHASE_ENUMERATE_FONT_SUBSTITUTES] = {.name = "enumerate font substitutes"},
+    [PHASE_SEARCH]                     = {.name = "search"},
+    [PHASE_SUBSTITUTE_CONSTRUCTION]    = {.name = "substitute construction"},
+    [PHASE_BACKUP_SERIALIZATION]       = {.name = "backup serialization"},
+    [PHASE_OUTPUT_SERIALIZATION]       = {.name = "output serialization"},
+    [PHASE_FILE_WRITES]                = {.name = "file writes"},
+    [PHASE_CACHE]                      = {.name = "cache"},
+    [PHASE_DIFF]                       = {.name = "diff"},
+    [PHASE_RECOVERY]                   = {.name = "journal recovery"},
+    [PHASE_RESTORE_READ]               = {.name = "backup read"},
+    [PHASE_RESTORE_ENUMERATE]          = {.name = "enumerate restored keys"},
+    [PHASE_JOURNAL]                    = {.name = "journal write"},
+    [PHASE_APPLY]                      = {.name = "registry apply"},
+    [PHASE_VERIFY]                     = {.name = "registry read-back"},
+};
+// The phase that allocations are currently attributed to, per thread as the backup is taken on its own thread
+_Thread_local Phase current_phase = PHASE_OTHER;
+
+// Counts the allocation towards the current phase
+// The counters are shared by all threads, so they are added to atomically
+void* stats_realloc(void* ptr, size_t size) {
+    __atomic_fetch_add(&phase_stats[current_phase].allocations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&phase_stats[current_phase].bytes, size, __ATOMIC_RELAXED);
+    return realloc(ptr, size);
+}
+
+// Start measuring a phase
+// Returns the start time that needs to be passed to phase_end
+LONGLONG phase_begin(Phase phase) {
+    current_phase = phase;
+    trace_begin(phase_stats[phase].name);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+// Stop measuring a phase, adding the elapsed time since phase_begin to it
+void phase_end(Phase phase, LONGLONG start) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    phase_stats[phase].ticks += now.QuadPart - start;
+    current_phase = PHASE_OTHER;
+    trace_end(phase_stats[phase].name);
+}
 
-    sb_append_cstr(sb, temp_sprintf("hex(%ld):", value->type_hex_type));
-    for (size_t i = 0; i < value->data_len; ++i) {
-        if (i > 0)
-            da_append(sb, ',');
-        sb_append_cstr(sb, temp_sprintf("%x", value->data[i]));
+// Convert QueryPerformanceCounter ticks to milliseconds
+double stats_ticks_to_ms(LONGLONG ticks) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (double) ticks * 1000.0 / (double) frequency.QuadPart;
+}
+
+// Print the phase measurements as a table
+void stats_print() {
+    fprintf(stderr, "\n");
+    fprintf(stderr, "%-28s %12s %12s %14s\n", "Phase", "Time (ms)", "Allocations", "Bytes");
+    for (size_t i = 0; i < PHASE_COUNT; ++i) {
+        fprintf(stderr, "%-28s %12.3f %12zu %14zu\n", phase_stats[i].name,
+            stats_ticks_to_ms(phase_stats[i].ticks), phase_stats[i].allocations, phase_stats[i].bytes);
     }
+    fprintf(stderr, "%-28s %40zu\n", "Peak temporary bytes", temp_peak());
+    fprintf(stderr, "\n");
 }
 
-// Add registry values of a key to a string builder in the form of a .reg file
-// Doesn't add a header or clear the string builder, to allow for multiple keys per file
+// Write the phase measurements to a JSON file
 // Returns true on success, false on failure
-bool reg_key_add_to_file(const char* registry_path, const Registry_Value_List list, String_Builder* sb) {
-    sb_append_cstr(sb, "\n");
-    sb_append_cstr(sb, temp_sprintf("[HKEY_LOCAL_MACHINE\\%s]\n", registry_path));
-    for (size_t i = 0; i < list.count; ++i) {
-        // Add the value name
-        sb_append_cstr(sb, "\"");
-        sb_append_escaped(sb, list.items[i].name);
-        sb_append_cstr(sb, "\"=");
-
-        // Add the value data
-        switch (list.items[i].type) {
-        case REG_TYPE_STRING:
-            sb_append_cstr(sb, "\"");
-            sb_append_escaped(sb, list.items[i].data);
-            sb_append_cstr(sb, "\"");
-            break;
-        case REG_TYPE_HEX:
-            reg_sb_append_hex(sb, &list.items[i]);
-            break;
-        case REG_TYPE_DELETE:
-            da_append(sb, '-');
-            break;
+bool stats_write_json(const char* path) {
+    String_Builder json = {0};
+    sb_append_cstr(&json, "{\"phases\":[");
+    for (size_t i = 0; i < PHASE_COUNT; ++i) {
+        if (i > 0) da_append(&json, ',');
+        temp_scope() {
+            sb_append_cstr(&json, temp_sprintf("{\"name\":\"%s\",\"ms\":%.3f,\"allocations\":%zu,\"bytes\":%zu}",
+                phase_stats[i].name, stats_ticks_to_ms(phase_stats[i].ticks), phase_stats[i].allocations, phase_stats[i].bytes));
         }
-
-        sb_append_cstr(sb, "\n");
     }
-    return true;
+    temp_scope() sb_append_cstr(&json, temp_sprintf("],\"temp_peak_bytes\":%zu}\n", temp_peak()));
+    bool result = write_entire_file(path, json.items, json.count);
+    sb_free(json);
+    return result;
 }
 
-// Add registry values of a key to a string builder in the form of a .reg file
-// Resets the string builder and adds the header
+// Get all of the values for the HKEY parent_key, add them to result->list, and set the last write time of result
+// If the key hasn't been written to since it was stored in the cache, the values are taken from the cache instead
+// Sets cached to whether the values were taken from the cache
 // Returns true on success, false on failure
-bool reg_key_get_file(const char* registry_path, const Registry_Value_List list, String_Builder* sb) {
-    sb->count = 0;
-    sb_append_cstr(sb, "Windows Registry Editor Version 5.00\n");
-    return reg_key_add_to_file(registry_path, list, sb);
+bool reg_key_list_values_cached(HKEY parent_key, const Registry_Snapshot* cache, Registry_Key* result, bool* cached) {
+    DWORD amount_of_values = 0;
+    uint64_t last_write_time = 0;
+    if (!reg_key_query_info(parent_key, &amount_of_values, &last_write_time)) return false;
+
+    *cached = false;
+    if (cache->base != NULL) {
+        size_t start = result->list.count;
+        if (reg_snapshot_get_key(cache, result)
+            && result->last_write_time == last_write_time
+            && result->list.count - start == amount_of_values
+        ) {
+            *cached = true;
+            return true;
+        }
+        // The key has changed since it was cached, throw the cached values away
+        result->list.count = start;
+    }
+
+    result->last_write_time = last_write_time;
+    return reg_key_enumerate_values(parent_key, amount_of_values, &result->list);
 }
 
 // Utility function to determine whether the program is executed with administrative privileges
@@ -212,6 +309,17 @@ bool str_contains(const char* haystack, const char* needle) {
     return false;
 }
 
+// Read a line from standard input into buffer and remove the trailing newline
+// Returns true on success, false on end of input
+bool read_line(char* buffer, size_t capacity) {
+    memset(buffer, 0, sizeof(*buffer) * capacity);
+    if (fgets(buffer, capacity, stdin) == NULL) return false;
+    size_t len = strlen(buffer);
+    if (len > 0 && buffer[len - 1] == '\n')
+        buffer[len - 1] = 0;
+    return true;
+}
+
 // Print a welcome message
 void print_welcome() {
     printf("\n\n");
@@ -227,23 +335,418 @@ void print_welcome() {
     printf("\n");
 }
 
-// Registry paths
-#define FONTS_REGISTRY_PATH "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts"
-#define FONT_SUBSTITUTES_REGISTRY_PATH "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontSubstitutes"
-#define FONT_LINK_REGISTRY_PATH "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontLink\\SystemLink"
-
 #define BACKUP_FONTS_REG_FILENAME "backup_fonts.reg"
+#define BACKUP_FONTS_SNAPSHOT_FILENAME "backup_fonts.snapshot"
+// Snapshot of the keys of the previous run, used to skip the enumeration of unchanged keys
+#define CACHE_SNAPSHOT_FILENAME "changefont_cache.snapshot"
+// Content-addressed store of every backup, with an index of when each one was taken
+#define BACKUPS_DIRNAME "backups"
+#define BACKUPS_INDEX_FILENAME "index.txt"
+// Write-ahead journal of --apply, which only exists while the registry is being changed
+#define JOURNAL_FILENAME "changefont.journal"
+
+// Store a backup in dir/backups, under the XXH64 hash of its .reg file
+// A backup that is already stored is only added to the index again, without writing its files
+// If compress is set, new backups are written compressed, with .lz appended to their file names
+// Sets name to the hash of the backup, and stored to whether its files were written
+// Returns true on success, false on failure
+bool backup_store(const char* dir, const String_Builder* reg, const String_Builder* snapshot, bool compress, char name[17], bool* stored) {
+    const char* backups_dir = temp_sprintf("%s/%s", dir, BACKUPS_DIRNAME);
+    if (!mkdir_if_not_exists(backups_dir)) return false;
+
+    snprintf(name, 17, "%016llx", (unsigned long long) reg_hash64(reg->items, reg->count, 0));
+    const char* reg_path = temp_sprintf("%s/%s.reg", backups_dir, name);
+    const char* compressed_reg_path = temp_sprintf("%s.lz", reg_path);
+    *stored = false;
+    if (!file_exists(reg_path) && !file_exists(compressed_reg_path)) {
+        // The .reg file is written last, so a backup only counts as stored once both files are complete
+        const char* snapshot_path = temp_sprintf("%s/%s.snapshot", backups_dir, name);
+        if (compress) {
+            if (!reg_lz_write_file(temp_sprintf("%s.lz", snapshot_path), snapshot->items, snapshot->count)) return false;
+            if (!reg_lz_write_file(compressed_reg_path, reg->items, reg->count)) return false;
+        } else {
+            // The name is the hash of the whole .reg file, so it is only written once it is serialized
+            if (!write_entire_file_atomic(snapshot_path, snapshot->items, snapshot->count)) return false;
+            if (!write_entire_file_atomic(reg_path, reg->items, reg->count)) return false;
+        }
+        *stored = true;
+    }
+
+    // Record when the backup was taken
+    const char* index_path = temp_sprintf("%s/%s", backups_dir, BACKUPS_INDEX_FILENAME);
+    FILE* index = fopen(index_path, "ab");
+    if (index == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", index_path, strerror(errno));
+        return false;
+    }
+    SYSTEMTIME time;
+    GetSystemTime(&time);
+    fprintf(index, "%04u-%02u-%02uT%02u:%02u:%02uZ %s\n",
+        time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond, name);
+    bool result = ferror(index) == 0;
+    if (fclose(index) != 0 || !result) {
+        nob_log(NOB_ERROR, "Couldn't write to %s", index_path);
+        return false;
+    }
+    return true;
+}
+
+// Write a file, unless it already exists with the same contents
+// The whole file has to be serialized to compare it, so it isn't streamed while it is serialized.
+// Sets written to whether the file was written
+// Returns true on success, false on failure
+bool write_entire_file_if_changed(const char* path, const void* data, size_t size, bool* written) {
+    *written = false;
+    if (file_exists(path)) {
+        // Compare against the file in place, instead of reading it into memory first
+        String_View existing;
+        if (map_file(path, &existing, MAP_SEQUENTIAL)) {
+            bool same = existing.count == size && memcmp(existing.data, data, size) == 0;
+            unmap_file(existing);
+            if (same) return true;
+        }
+    }
+    *written = true;
+    return write_entire_file_atomic(path, data, size);
+}
+
+// Backup of the font keys, which is taken on its own thread while the user chooses a font
+typedef struct {
+    const char* dir;
+    Font_Keys keys;
+    bool compress;
+    // The font substitutes derived from the keys, which the change needs as well
+    Registry_Value_List substitute_list;
+    // The backup as a .reg file
+    String_Builder reg;
+    // Hash of the backup in the store, and whether it wasn't stored before
+    char name[17];
+    bool stored;
+    // Whether the backup was also written next to the executable
+    bool first;
+    bool result;
+    HANDLE thread;
+    // Level of the log messages before the thread was started
+    Nob_Log_Level log_level;
+} Backup;
+
+// Serialize the keys of a backup and write them to the backup store, and next to the executable if there is no backup yet
+// Only logs errors, the rest is reported by backup_wait, so nothing gets in the way of the prompts
+DWORD WINAPI backup_take(LPVOID arg) {
+    Backup* backup = arg;
+    String_Builder snapshot = {0};
+
+    LONGLONG phase_start = phase_begin(PHASE_SUBSTITUTE_CONSTRUCTION);
+    font_substitute_list_build(&backup->keys, &backup->substitute_list);
+    phase_end(PHASE_SUBSTITUTE_CONSTRUCTION, phase_start);
+
+    // Serialize the pre-modified registry values, both as a .reg file and as a binary snapshot
+    phase_start = phase_begin(PHASE_BACKUP_SERIALIZATION);
+    backup->result = font_backup_get_file(&backup->keys, backup->substitute_list, &backup->reg);
+    Registry_Key snapshot_keys[] = {backup->keys.fonts, backup->keys.font_substitutes, backup->keys.font_links};
+    reg_snapshot_serialize(snapshot_keys, ARRAY_LEN(snapshot_keys), &snapshot);
+    phase_end(PHASE_BACKUP_SERIALIZATION, phase_start);
+
+    if (backup->result) {
+        phase_start = phase_begin(PHASE_FILE_WRITES);
+        // Every run is kept in the backup store, identical states only take up a line in its index
+        backup->result = backup_store(backup->dir, &backup->reg, &snapshot, backup->compress, backup->name, &backup->stored);
+        // The first backup is also kept next to the executable, don't overwrite it
+        if (backup->result && !file_exists(temp_sprintf("%s/%s", backup->dir, BACKUP_FONTS_REG_FILENAME))) {
+            // Write the state of the keys as a binary snapshot next to the backup
+            // The .reg file is put in place last, as its existence means that the backup is complete
+            backup->first = true;
+            backup->result = write_entire_file_atomic(temp_sprintf("%s/%s", backup->dir, BACKUP_FONTS_SNAPSHOT_FILENAME), snapshot.items, snapshot.count)
+                          && write_entire_file_atomic(temp_sprintf("%s/%s", backup->dir, BACKUP_FONTS_REG_FILENAME), backup->reg.items, backup->reg.count);
+        }
+        phase_end(PHASE_FILE_WRITES, phase_start);
+    }
+
+    sb_free(snapshot);
+    // Every thread has its own temporary allocator, which the file paths above are built in
+    temp_free();
+    return 0;
+}
+
+// Start taking a backup of the keys on its own thread
+// If the thread can't be created, the backup is taken right away instead
+void backup_start(Backup* backup) {
+    // The directories and files that are written would otherwise be logged in between the prompts
+    backup->log_level = nob_minimal_log_level;
+    if (nob_minimal_log_level < NOB_WARNING) nob_minimal_log_level = NOB_WARNING;
+    backup->thread = CreateThread(NULL, 0, backup_take, backup, 0, NULL);
+    if (backup->thread == NULL) {
+        nob_log(NOB_WARNING, "Couldn't create the backup thread: %ld, taking the backup now", GetLastError());
+        backup_take(backup);
+        nob_minimal_log_level = backup->log_level;
+    }
+}
+
+// Wait until the thread of a backup has finished
+// Does nothing if it already has, or was never started
+void backup_join(Backup* backup) {
+    if (backup->thread == NULL) return;
+    WaitForSingleObject(backup->thread, INFINITE);
+    CloseHandle(backup->thread);
+    backup->thread = NULL;
+    nob_minimal_log_level = backup->log_level;
+}
+
+// Wait until the backup is taken, and report where it was written to
+// Returns true on success, false on failure
+bool backup_wait(Backup* backup) {
+    backup_join(backup);
+    if (!backup->result) return false;
+
+    if (backup->stored) {
+        nob_log(NOB_INFO, "Stored backup %s in %s/%s", backup->name, backup->dir, BACKUPS_DIRNAME);
+    } else {
+        nob_log(NOB_INFO, "The registry is in the same state as backup %s, not storing it again", backup->name);
+    }
+    if (backup->first) {
+        nob_log(NOB_INFO, "Wrote fonts snapshot file to %s/%s", backup->dir, BACKUP_FONTS_SNAPSHOT_FILENAME);
+        nob_log(NOB_INFO, "Wrote fonts backup file to %s/%s", backup->dir, BACKUP_FONTS_REG_FILENAME);
+    } else {
+        nob_log(NOB_INFO, "A backup already exists next to the executable, not overwriting it.");
+    }
+    return true;
+}
+
+// Undo the changes of an --apply that was interrupted, or finish them if roll_forward is set
+// The journal is removed once the registry is back in a known state
+// Returns true on success, false on failure
+bool journal_recover(const char* path, bool roll_forward) {
+    bool result = true;
+    Registry_Journal journal = {0};
+    if (!reg_journal_read(path, &journal)) return false;
 
-int main() {
+    if (!journal.complete) {
+        // The journal is flushed before the registry is touched, so nothing was changed yet
+        nob_log(NOB_WARNING, "Removing the incomplete journal %s, the registry wasn't changed", path);
+    } else {
+        if (!util_is_admin()) {
+            nob_log(NOB_ERROR, "A previous --apply was interrupted, run this tool with Administrator privileges to recover from %s", path);
+            return_defer(false);
+        }
+        const Registry_Snapshot* snapshot = roll_forward ? &journal.redo : &journal.undo;
+        nob_log(NOB_INFO, "A previous --apply was interrupted, %s its %u changed keys", roll_forward ? "finishing" : "undoing", snapshot->header->key_count);
+        if (!reg_snapshot_apply(snapshot)) return_defer(false);
+    }
+    if (!DeleteFileA(path)) {
+        nob_log(NOB_ERROR, "Couldn't remove journal %s: %ld", path, GetLastError());
+        return_defer(false);
+    }
+
+defer:
+    reg_journal_free(&journal);
+    return result;
+}
+
+// A key that is restored from a backup
+typedef struct {
+    HKEY handle;
+    Registry_Value_List live;
+    Registry_Key_Diff diff;
+} Restore_Key;
+
+typedef struct {
+    Restore_Key* items;
+    size_t count;
+    size_t capacity;
+} Restore_Keys;
+
+// Bring the keys in a backup back to the state of the backup, only writing the values that differ
+// The changes are journaled like --apply
+// Returns true on success, false on failure
+bool restore_backup(const char* backup_path, const char* journal_path) {
+    bool result = true;
+    LONGLONG phase_start = 0;
+    Registry_File backup = {0};
+    Restore_Keys keys = {0};
+    Registry_Key_List undo = {0};
+    Registry_Key_List redo = {0};
+    size_t changes = 0;
+
+    phase_start = phase_begin(PHASE_RESTORE_READ);
+    bool read = reg_file_read(backup_path, &backup);
+    phase_end(PHASE_RESTORE_READ, phase_start);
+    if (!read) return_defer(false);
+
+    for (size_t i = 0; i < backup.keys.count; ++i) {
+        const Registry_Key* key = &backup.keys.items[i];
+        Restore_Key restore_key = {0};
+        // A key that was deleted in the backup ends up without values, the key itself is kept
+        const Registry_Value_List target = key->deleted ? (Registry_Value_List) {0} : key->list;
+
+        phase_start = phase_begin(PHASE_REGISTRY_OPEN);
+        // Keys that are missing are created, their values are all added back
+        long code = RegCreateKeyExA(HKEY_LOCAL_MACHINE, key->path, 0, NULL, REG_OPTION_NON_VOLATILE, KEY_READ | KEY_SET_VALUE, NULL, &restore_key.handle, NULL);
+        phase_end(PHASE_REGISTRY_OPEN, phase_start);
+        if (code != ERROR_SUCCESS) {
+            nob_log(NOB_ERROR, "Failed to open key %s: %ld", key->path, code);
+            return_defer(false);
+        }
+        // Add the key right away, so its handle is closed if anything goes wrong
+        da_append(&keys, restore_key);
+        Restore_Key* live_key = &keys.items[keys.count - 1];
+
+        // The backup can have any key, so they aren't counted as the font keys of a normal run
+        phase_start = phase_begin(PHASE_RESTORE_ENUMERATE);
+        bool listed = reg_key_list_values(live_key->handle, &live_key->live);
+        phase_end(PHASE_RESTORE_ENUMERATE, phase_start);
+        if (!listed) return_defer(false);
+
+        phase_start = phase_begin(PHASE_DIFF);
+        reg_key_diff_states(live_key->live, target, &live_key->diff);
+        phase_end(PHASE_DIFF, phase_start);
+        changes += live_key->diff.patch.count;
+
+        Registry_Key undo_key = {.path = key->path, .list = live_key->diff.restore};
+        Registry_Key redo_key = {.path = key->path, .list = live_key->diff.patch};
+        da_append(&undo, undo_key);
+        da_append(&redo, redo_key);
+    }
+    if (changes == 0) {
+        nob_log(NOB_INFO, "The registry already matches %s", backup_path);
+        return_defer(true);
+    }
+
+    phase_start = phase_begin(PHASE_JOURNAL);
+    bool journaled = reg_journal_write(journal_path, undo.items, redo.items, undo.count);
+    phase_end(PHASE_JOURNAL, phase_start);
+    if (!journaled) return_defer(false);
+
+    phase_start = phase_begin(PHASE_APPLY);
+    for (size_t i = 0; i < keys.count; ++i) {
+        if (!reg_key_apply(keys.items[i].handle, keys.items[i].diff.patch)) {
+            phase_end(PHASE_APPLY, phase_start);
+            nob_log(NOB_ERROR, "The backup was only partly restored, run this tool again to undo that");
+            return_defer(false);
+        }
+    }
+    phase_end(PHASE_APPLY, phase_start);
+
+    phase_start = phase_begin(PHASE_VERIFY);
+    for (size_t i = 0; i < keys.count; ++i) {
+        if (!reg_key_verify_patch(keys.items[i].handle, keys.items[i].diff.patch)) {
+            phase_end(PHASE_VERIFY, phase_start);
+            nob_log(NOB_ERROR, "The registry doesn't match the backup after restoring it, run this tool again to undo that");
+            return_defer(false);
+        }
+    }
+    phase_end(PHASE_VERIFY, phase_start);
+    nob_log(NOB_INFO, "Restored %zu values from %s", changes, backup_path);
+    if (!DeleteFileA(journal_path)) {
+        nob_log(NOB_ERROR, "Couldn't remove journal %s: %ld", journal_path, GetLastError());
+        return_defer(false);
+    }
+
+defer:
+    for (size_t i = 0; i < keys.count; ++i) {
+        RegCloseKey(keys.items[i].handle);
+        reg_key_diff_free(&keys.items[i].diff);
+        reg_value_list_free(&keys.items[i].live);
+    }
+    da_free(keys);
+    da_free(undo);
+    da_free(redo);
+    reg_file_free(&backup);
+    return result;
+}
+
+void log_usage(Nob_Log_Level level, const char* program) {
+    nob_log(level, "Usage: %s [options]", program);
+}
+
+void log_options(Nob_Log_Level level) {
+    nob_log(level, "Available options:");
+    nob_log(level, "  --stats              Print the time and allocations of every phase");
+    nob_log(level, "  --stats-json <file>  Write the time and allocations of every phase to a JSON file");
+    nob_log(level, "  --trace <file>       Write a Chrome trace-event file of all phases and registry calls");
+    nob_log(level, "  --no-cache           Always enumerate the registry keys, and don't update the cache");
+    nob_log(level, "  --compress           Compress the backups that are added to the backup store");
+    nob_log(level, "  --apply              Write the changes to the registry directly, instead of only generating .reg files");
+    nob_log(level, "  --roll-forward       Finish an interrupted --apply, instead of undoing it");
+    nob_log(level, "  --restore <backup>   Write the values that differ from a backup .reg file or snapshot to the registry");
+}
+
+int main(int argc, char** argv) {
     int result = 0;
     HKEY fonts_key = 0;
     HKEY font_substitutes_key = 0;
     HKEY font_link_key = 0;
+    LONGLONG phase_start = 0;
+    Registry_Snapshot cache = {0};
+    String_Builder cache_sb = {0};
+    Backup backup = {0};
+    Registry_Name_Table font_names = {0};
+    char cache_file_path[MAX_PATH] = {0};
+    char journal_file_path[MAX_PATH] = {0};
+
+    const char* program = shift(argv, argc);
+
+    bool print_stats = false;
+    const char* stats_json_path = NULL;
+    const char* trace_path = NULL;
+    bool use_cache = true;
+    bool compress = false;
+    bool apply = false;
+    bool roll_forward = false;
+    const char* restore_path = NULL;
+    // Parse the options
+    while (argc > 0) {
+        const char* option = shift(argv, argc);
+        if (strcmp(option, "--stats") == 0) {
+            print_stats = true;
+        } else if (strcmp(option, "--stats-json") == 0) {
+            if (argc < 1) {
+                log_usage(NOB_ERROR, program);
+                nob_log(NOB_ERROR, "Missing stats file path");
+                return 1;
+            }
+            stats_json_path = shift(argv, argc);
+        } else if (strcmp(option, "--trace") == 0) {
+            if (argc < 1) {
+                log_usage(NOB_ERROR, program);
+                nob_log(NOB_ERROR, "Missing trace file path");
+                return 1;
+            }
+            trace_path = shift(argv, argc);
+            trace_enabled = true;
+        } else if (strcmp(option, "--no-cache") == 0) {
+            use_cache = false;
+        } else if (strcmp(option, "--compress") == 0) {
+            compress = true;
+        } else if (strcmp(option, "--apply") == 0) {
+            apply = true;
+        } else if (strcmp(option, "--roll-forward") == 0) {
+            roll_forward = true;
+        } else if (strcmp(option, "--restore") == 0) {
+            if (argc < 1) {
+                log_usage(NOB_ERROR, program);
+                nob_log(NOB_ERROR, "Missing backup file path");
+                return 1;
+            }
+            restore_path = shift(argv, argc);
+        } else if (strcmp(option, "--help") == 0) {
+            log_usage(NOB_INFO, program);
+            log_options(NOB_INFO);
+            return 0;
+        } else {
+            log_usage(NOB_ERROR, program);
+            log_options(NOB_ERROR);
+            nob_log(NOB_ERROR, "Invalid option %s", option);
+            return 1;
+        }
+    }
 
-    // if (!util_is_admin()) {
-    //     nob_log(NOB_ERROR, "You need to run this tool with Administrator privileges!");
-    //     return_defer(10);
-    // }
+    // Only writing to HKEY_LOCAL_MACHINE needs administrative privileges
+    if ((apply || restore_path != NULL) && !util_is_admin()) {
+        nob_log(NOB_ERROR, "You need to run this tool with Administrator privileges to use %s!", apply ? "--apply" : "--restore");
+        return_defer(10);
+    }
+    // The keys are only opened once, so open them for writing right away when applying
+    REGSAM key_access = apply ? KEY_READ | KEY_SET_VALUE : KEY_READ;
 
     char exe_dir[MAX_PATH];
     // Get the executable path and path length
@@ -261,52 +764,133 @@ int main() {
         }
     }
 
+    // Recover from an --apply that was interrupted, before reading the registry
+    snprintf(journal_file_path, MAX_PATH, "%s/%s", exe_dir, JOURNAL_FILENAME);
+    if (file_exists(journal_file_path)) {
+        phase_start = phase_begin(PHASE_RECOVERY);
+        bool recovered = journal_recover(journal_file_path, roll_forward);
+        phase_end(PHASE_RECOVERY, phase_start);
+        if (!recovered) return_defer(1);
+    }
+
+    // Restoring a backup doesn't need anything else
+    if (restore_path != NULL) {
+        if (!restore_backup(restore_path, journal_file_path)) return_defer(1);
+        return_defer(0);
+    }
+
+    // Load the keys of the previous run from the cache
+    snprintf(cache_file_path, MAX_PATH, "%s/%s", exe_dir, CACHE_SNAPSHOT_FILENAME);
+    if (use_cache && file_exists(cache_file_path)) {
+        phase_start = phase_begin(PHASE_CACHE);
+        if (reg_snapshot_load(cache_file_path, &cache) && !reg_snapshot_verify(&cache)) {
+            nob_log(NOB_WARNING, "The cache %s is corrupted, ignoring it", cache_file_path);
+            reg_snapshot_unload(&cache);
+        }
+        phase_end(PHASE_CACHE, phase_start);
+    }
+    bool cached = false;
+    bool all_cached = true;
+
     // Open the key for fonts
-    long code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, FONTS_REGISTRY_PATH, 0, KEY_READ, &fonts_key);
+    phase_start = phase_begin(PHASE_REGISTRY_OPEN);
+    long code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, FONTS_REGISTRY_PATH, 0, key_access, &fonts_key);
+    phase_end(PHASE_REGISTRY_OPEN, phase_start);
     if (code != ERROR_SUCCESS) {
         nob_log(NOB_ERROR, "Failed to open key %s: %ld", FONTS_REGISTRY_PATH, code);
         return_defer(40);
     }
     // Get the values of the fonts key
-    Registry_Value_List font_list = {0};
-    if (!reg_key_list_values(fonts_key, &font_list)) return_defer(1);
-    nob_log(NOB_INFO, "Amount of fonts: %zu", font_list.count);
+    Registry_Key fonts = {.path = FONTS_REGISTRY_PATH};
+    phase_start = phase_begin(PHASE_ENUMERATE_FONTS);
+    bool listed = reg_key_list_values_cached(fonts_key, &cache, &fonts, &cached);
+    phase_end(PHASE_ENUMERATE_FONTS, phase_start);
+    if (!listed) return_defer(1);
+    all_cached = all_cached && cached;
+    Registry_Value_List font_list = fonts.list;
+    nob_log(NOB_INFO, "Amount of fonts: %zu%s", font_list.count, cached ? " (cached)" : "");
 
     // Open the font link key
-    code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, FONT_LINK_REGISTRY_PATH, 0, KEY_READ, &font_link_key);
+    phase_start = phase_begin(PHASE_REGISTRY_OPEN);
+    code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, FONT_LINK_REGISTRY_PATH, 0, key_access, &font_link_key);
+    phase_end(PHASE_REGISTRY_OPEN, phase_start);
     if (code != ERROR_SUCCESS) {
         nob_log(NOB_ERROR, "Failed to open key %s: %ld", FONT_LINK_REGISTRY_PATH, code);
         return_defer(41);
     }
     // Get the values of the font link key
-    Registry_Value_List font_link_list = {0};
-    if (!reg_key_list_values(font_link_key, &font_link_list)) return_defer(1);
-    nob_log(NOB_INFO, "Amount of font links: %zu", font_link_list.count);
+    Registry_Key font_links = {.path = FONT_LINK_REGISTRY_PATH};
+    phase_start = phase_begin(PHASE_ENUMERATE_FONT_LINKS);
+    listed = reg_key_list_values_cached(font_link_key, &cache, &font_links, &cached);
+    phase_end(PHASE_ENUMERATE_FONT_LINKS, phase_start);
+    if (!listed) return_defer(1);
+    all_cached = all_cached && cached;
+    Registry_Value_List font_link_list = font_links.list;
+    nob_log(NOB_INFO, "Amount of font links: %zu%s", font_link_list.count, cached ? " (cached)" : "");
+
+    // Open the font substitutes registry path
+    phase_start = phase_begin(PHASE_REGISTRY_OPEN);
+    code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, FONT_SUBSTITUTES_REGISTRY_PATH, 0, key_access, &font_substitutes_key);
+    phase_end(PHASE_REGISTRY_OPEN, phase_start);
+    if (code != ERROR_SUCCESS) {
+        nob_log(NOB_ERROR, "Failed to open key %s: %ld", FONT_SUBSTITUTES_REGISTRY_PATH, code);
+        return_defer(40);
+    }
+    // Read the font substitutes registry path
+    Registry_Key font_substitutes = {.path = FONT_SUBSTITUTES_REGISTRY_PATH};
+    phase_start = phase_begin(PHASE_ENUMERATE_FONT_SUBSTITUTES);
+    listed = reg_key_list_values_cached(font_substitutes_key, &cache, &font_substitutes, &cached);
+    phase_end(PHASE_ENUMERATE_FONT_SUBSTITUTES, phase_start);
+    if (!listed) return_defer(1);
+    all_cached = all_cached && cached;
+    nob_log(NOB_INFO, "Amount of font substitutes: %zu%s", font_substitutes.list.count, cached ? " (cached)" : "");
+
+    // Update the cache if any of the keys had to be enumerated
+    // The cached values are still in use, so the file is only written once the cache is unloaded
+    if (use_cache && !all_cached) {
+        phase_start = phase_begin(PHASE_CACHE);
+        Registry_Key cache_keys[] = {fonts, font_substitutes, font_links};
+        reg_snapshot_serialize(cache_keys, ARRAY_LEN(cache_keys), &cache_sb);
+        phase_end(PHASE_CACHE, phase_start);
+    }
+
+    // The backup only depends on the keys, so take it while the user chooses a font
+    backup = (Backup) {
+        .dir = exe_dir,
+        .keys = {.fonts = fonts, .font_substitutes = font_substitutes, .font_links = font_links},
+        .compress = compress,
+    };
+    backup_start(&backup);
 
     // Print the welcome message
     print_welcome();
 
     printf("Now, you will choose a font to replace all other fonts with.\n");
     printf("The amount of fonts is probably too high to list them now.\nThat's why you can search through them.\n");
+    // Every query goes through all font names, so they are packed together without the data in between
+    reg_name_table_build(font_list, &font_names);
 retry_search_query:
     printf("Search query: ");
     #define QUERY_MAX_LEN 128
     char query[QUERY_MAX_LEN] = {0};
-    // Get query from standard input and remove trailing newline
-    fgets(query, QUERY_MAX_LEN, stdin);
-    size_t query_len = strlen(query);
-    if (query[query_len - 1] == '\n')
-        query[query_len - 1] = 0;
+    // Get query from standard input
+    if (!read_line(query, QUERY_MAX_LEN)) {
+        nob_log(NOB_ERROR, "Unexpected end of input");
+        return_defer(1);
+    }
 
     printf("Fonts that match the query:\n");
     bool found_font = false;
     // List the fonts that match the search query
-    for (size_t i = 0; i < font_list.count; ++i) {
-        if (str_contains(font_list.items[i].name, query)) {
-            printf("  [%zu] %s\n", i, font_list.items[i].name);
+    phase_start = phase_begin(PHASE_SEARCH);
+    for (size_t i = 0; i < font_names.count; ++i) {
+        const char* name = reg_name_table_get(&font_names, i);
+        if (str_contains(name, query)) {
+            printf("  [%zu] %s\n", i, name);
             found_font = true;
         }
     }
+    phase_end(PHASE_SEARCH, phase_start);
     // If no fonts are found, ask the user to search again
     if (!found_font) {
         nob_log(NOB_ERROR, "No fonts were found, try again.");
@@ -314,14 +898,12 @@ retry_search_query:
     }
     
 retry_number_query:
-    // Reset the query buffer
-    memset(query, 0, sizeof(*query) * QUERY_MAX_LEN);
     printf("Enter the number of the font you want: ");
-    // Get query from standard input again and remove trailing newline
-    fgets(query, QUERY_MAX_LEN, stdin);
-    query_len = strlen(query);
-    if (query[query_len - 1] == '\n')
-        query[query_len - 1] = 0;
+    // Get query from standard input again
+    if (!read_line(query, QUERY_MAX_LEN)) {
+        nob_log(NOB_ERROR, "Unexpected end of input");
+        return_defer(1);
+    }
     int font_index = atoi(query);
     // If the number is invalid, prompt the user to try again
     if (font_index < 0 || font_index >= (int) font_list.count) {
@@ -331,115 +913,136 @@ retry_number_query:
     
     printf("\n");
     printf("This will create a .reg file to replace ALL fonts with `%s`.\n", font_list.items[font_index].name);
-    printf("A backup .reg file will be created and can be restored later.\n");
-    memset(query, 0, sizeof(*query) * QUERY_MAX_LEN);
+    printf("A backup .reg file is created either way and can be restored later.\n");
     printf("Do you want to continue? [Y/n] ");
-    fgets(query, QUERY_MAX_LEN, stdin);
-
-    // We don't need to strip the trailing newline, because only the first character is checked
-    if (tolower(query[0]) == 'n') return 0;
-
-    Registry_Value_List font_substitute_list = {0};
-
-    // Set up font substitute list for the backup
-    for (size_t i = 0; i < font_list.count; ++i) {
-        Registry_Value val = {
-            .name = malloc(sizeof(char) * font_list.items[i].name_len),
-            .name_len = font_list.items[i].name_len,
-            .data = NULL,
-            .data_len = 0,
-            // This value needs to be deleted to restore the original state
-            .type = REG_TYPE_DELETE,
-        };
+    if (!read_line(query, QUERY_MAX_LEN)) {
+        nob_log(NOB_ERROR, "Unexpected end of input");
+        return_defer(1);
+    }
 
-        // Copy the font item name into this value's name
-        memcpy(val.name, font_list.items[i].name, sizeof(char) * font_list.items[i].name_len);
-        // Remove trailing zeroes
-        while (val.name[val.name_len - 1] == '\0') --val.name_len;
-        
-        // Remove trailing bracketed information (e.g. ` (TrueType)`) as it is not part of the font name
-        if (val.name[val.name_len - 1] == ')') {
-            while (val.name_len > 0 && val.name[val.name_len - 1] != '(')
-                --val.name_len;
-            --val.name_len;
-            if (val.name_len > 0 && val.name[val.name_len - 1] == ' ')
-                --val.name_len;
-        }
-        // Add back in a trailing zero
-        val.name[val.name_len] = '\0';
+    // Only the first character is checked
+    // The backup is taken either way
+    if (tolower(query[0]) == 'n') return_defer(backup_wait(&backup) ? 0 : 1);
 
-        // Add the value to the font substitute list
-        da_append(&font_substitute_list, val);
-    }
+    // Only the modified files are left to write once the backup is taken
+    if (!backup_wait(&backup)) return_defer(1);
+    Font_Keys font_keys = backup.keys;
+    Registry_Value_List font_substitute_list = backup.substitute_list;
+    String_Builder font_reg = backup.reg;
 
-    // Open the font substitutes registry path
-    code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, FONT_SUBSTITUTES_REGISTRY_PATH, 0, KEY_READ, &font_substitutes_key);
-    if (code != ERROR_SUCCESS) {
-        nob_log(NOB_ERROR, "Failed to open key %s: %ld", FONT_SUBSTITUTES_REGISTRY_PATH, code);
-        return_defer(40);
-    }
-    // Read the font substitutes registry path
-    if (!reg_key_list_values(font_substitutes_key, &font_substitute_list)) return_defer(1);
-    nob_log(NOB_INFO, "Amount of font substitutes: %zu", font_substitute_list.count);
-
-    String_Builder font_reg = {0};
-    // If a backup already exists, don't overwrite it
-    if (file_exists(temp_sprintf("%s/%s", exe_dir, BACKUP_FONTS_REG_FILENAME))
-    ) {
-        nob_log(NOB_WARNING, "A backup already exists! Not overwriting the file.");
-    } else {
-        // Write the pre-modified registry values to a string builder
-        if (!reg_key_get_file(FONTS_REGISTRY_PATH, font_list, &font_reg)) return 1;
-        if (!reg_key_add_to_file(FONT_SUBSTITUTES_REGISTRY_PATH, font_substitute_list, &font_reg)) return 1;
-        if (!reg_key_add_to_file(FONT_LINK_REGISTRY_PATH, font_link_list, &font_reg)) return 1;
-        // Construct the backup file path
-        char* fonts_backup_file_path = temp_sprintf("%s/%s", exe_dir, BACKUP_FONTS_REG_FILENAME);
-        // Write the string builder to the backup file
-        if (!write_entire_file(fonts_backup_file_path, font_reg.items, font_reg.count)) return false;
-        nob_log(NOB_INFO, "Wrote fonts backup file to %s", fonts_backup_file_path);
-        // Reset the temporary buffer, because it is used a lot in the reg_key_*_file functions
-        temp_reset();
-    }
-
-    // Remove the font paths (except for the chosen font)
-    for (size_t i = 0; i < font_list.count; ++i) {
-        if (i == (size_t) font_index) continue;
-        font_list.items[i].data = "";
-        font_list.items[i].data_len = 0;
-    }
-    // Set the font substitute to the chosen font
-    for (size_t i = 0; i < font_substitute_list.count; ++i) {
-        if (i == (size_t) font_index) continue;
-        font_substitute_list.items[i].data = font_substitute_list.items[font_index].name;
-        font_substitute_list.items[i].data_len = font_substitute_list.items[font_index].name_len;
-        font_substitute_list.items[i].type = REG_TYPE_STRING;
-    }
-    // Delete the font links
-    for (size_t i = 0; i < font_link_list.count; ++i) {
-        font_link_list.items[i].type = REG_TYPE_DELETE;
-    }
-
-    // Write the modified registry values to a string builder
-    if (!reg_key_get_file(FONTS_REGISTRY_PATH, font_list, &font_reg)) return 1;
-    if (!reg_key_add_to_file(FONT_SUBSTITUTES_REGISTRY_PATH, font_substitute_list, &font_reg)) return 1;
-    if (!reg_key_add_to_file(FONT_LINK_REGISTRY_PATH, font_link_list, &font_reg)) return 1;
+    // Only keep the values that actually change
+    Font_Change change = {0};
+    phase_start = phase_begin(PHASE_DIFF);
+    font_change_compute(&font_keys, font_substitute_list, (size_t) font_index, &change);
+    phase_end(PHASE_DIFF, phase_start);
+    nob_log(NOB_INFO, "Changed values: %zu fonts, %zu font substitutes, %zu font links",
+        change.fonts.patch.count, change.font_substitutes.patch.count, change.font_links.patch.count);
+
+    // Write the changes that undo this run to a string builder
+    phase_start = phase_begin(PHASE_OUTPUT_SERIALIZATION);
+    bool serialized = font_change_get_restore_file(&change, &font_reg);
+    phase_end(PHASE_OUTPUT_SERIALIZATION, phase_start);
+    if (!serialized) return_defer(1);
+    char* fonts_restore_file_path = temp_sprintf("%s/restore_fonts_%s.reg", exe_dir, font_list.items[font_index].name);
+    bool written = false;
+    phase_start = phase_begin(PHASE_FILE_WRITES);
+    bool stored = write_entire_file_if_changed(fonts_restore_file_path, font_reg.items, font_reg.count, &written);
+    phase_end(PHASE_FILE_WRITES, phase_start);
+    if (!stored) return_defer(1);
+    nob_log(NOB_INFO, "%s fonts restore file %s", written ? "Wrote" : "Unchanged", fonts_restore_file_path);
+
+    // Write the changed registry values to a string builder
+    phase_start = phase_begin(PHASE_OUTPUT_SERIALIZATION);
+    font_change_get_patch_file(&change, &font_reg);
+    phase_end(PHASE_OUTPUT_SERIALIZATION, phase_start);
     // Construct the font-changing .reg file path
     char* fonts_backup_file_path = temp_sprintf("%s/fonts_%s.reg", exe_dir, font_list.items[font_index].name);
     // Write the string builder to said path
-    if (!write_entire_file(fonts_backup_file_path, font_reg.items, font_reg.count)) return false;
-    nob_log(NOB_INFO, "Wrote fonts registry file to %s", fonts_backup_file_path);
-    // Reset the temporary buffer, because it is used a lot in the reg_key_*_file functions
+    phase_start = phase_begin(PHASE_FILE_WRITES);
+    stored = write_entire_file_if_changed(fonts_backup_file_path, font_reg.items, font_reg.count, &written);
+    phase_end(PHASE_FILE_WRITES, phase_start);
+    if (!stored) return_defer(1);
+    nob_log(NOB_INFO, "%s fonts registry file %s", written ? "Wrote" : "Unchanged", fonts_backup_file_path);
+    // Reset the temporary buffer, because the file paths above are built in it
     temp_reset();
 
+    if (apply) {
+        // Record the values before and after the change, so an interrupted apply can be recovered
+        Registry_Key undo[] = {
+            {.path = FONTS_REGISTRY_PATH, .list = change.fonts.restore},
+            {.path = FONT_SUBSTITUTES_REGISTRY_PATH, .list = change.font_substitutes.restore},
+            {.path = FONT_LINK_REGISTRY_PATH, .list = change.font_links.restore},
+        };
+        Registry_Key redo[] = {
+            {.path = FONTS_REGISTRY_PATH, .list = change.fonts.patch},
+            {.path = FONT_SUBSTITUTES_REGISTRY_PATH, .list = change.font_substitutes.patch},
+            {.path = FONT_LINK_REGISTRY_PATH, .list = change.font_links.patch},
+        };
+        phase_start = phase_begin(PHASE_JOURNAL);
+        bool journaled = reg_journal_write(journal_file_path, undo, redo, ARRAY_LEN(undo));
+        phase_end(PHASE_JOURNAL, phase_start);
+        if (!journaled) return_defer(1);
+
+        // Write the changes with the handles that are already open, one key at a time
+        phase_start = phase_begin(PHASE_APPLY);
+        bool applied = reg_key_apply(fonts_key, change.fonts.patch)
+                    && reg_key_apply(font_substitutes_key, change.font_substitutes.patch)
+                    && reg_key_apply(font_link_key, change.font_links.patch);
+        phase_end(PHASE_APPLY, phase_start);
+        if (!applied) {
+            nob_log(NOB_ERROR, "The changes were only partly applied, run this tool again to undo them");
+            return_defer(1);
+        }
+
+        // Read the keys back to make sure every write ended up in the registry
+        phase_start = phase_begin(PHASE_VERIFY);
+        bool verified = reg_key_verify_patch(fonts_key, change.fonts.patch)
+                     && reg_key_verify_patch(font_substitutes_key, change.font_substitutes.patch)
+                     && reg_key_verify_patch(font_link_key, change.font_links.patch);
+        phase_end(PHASE_VERIFY, phase_start);
+        if (!verified) {
+            nob_log(NOB_ERROR, "The registry doesn't match the changes after applying them, run this tool again to undo them");
+            return_defer(1);
+        }
+        nob_log(NOB_INFO, "Applied and verified %zu changed values", font_change_count(&change));
+        // The registry is in a known state again
+        if (!DeleteFileA(journal_file_path)) {
+            nob_log(NOB_ERROR, "Couldn't remove journal %s: %ld", journal_file_path, GetLastError());
+            return_defer(1);
+        }
+    }
+
     // Give some instructions on what to do in order to actually change the fonts
     printf("\n\n");
-    printf("You can now import the generated fonts_%s.reg file.\n", font_list.items[font_index].name);
+    if (apply) {
+        printf("The fonts have been changed, sign out and back in to see them everywhere.\n");
+    } else {
+        printf("You can now import the generated fonts_%s.reg file.\n", font_list.items[font_index].name);
+    }
+    printf("To undo only this change, import the generated restore_fonts_%s.reg file.\n", font_list.items[font_index].name);
     printf("To restore things to normal, import the "BACKUP_FONTS_REG_FILENAME" file.\n");
     printf("Have fun!\n");
     printf("\n");
 
 defer:
+    // The backup refers to the keys and the cache, and adds to the phase measurements
+    backup_join(&backup);
+    // Write the updated cache, now that nothing refers to the old one anymore
+    reg_snapshot_unload(&cache);
+    if (cache_sb.count > 0) {
+        phase_start = phase_begin(PHASE_CACHE);
+        if (write_entire_file(cache_file_path, cache_sb.items, cache_sb.count)) {
+            nob_log(NOB_INFO, "Updated the cache %s", cache_file_path);
+        }
+        phase_end(PHASE_CACHE, phase_start);
+    }
+    sb_free(cache_sb);
+    // Report the phase measurements, even when something went wrong halfway
+    if (print_stats) stats_print();
+    if (stats_json_path != NULL && !stats_write_json(stats_json_path)) result = 1;
+    if (trace_path != NULL && !trace_write_json(trace_path)) result = 1;
     // Cleanup
+    reg_name_table_free(&font_names);
     if (fonts_key) RegCloseKey(fonts_key);
     if (font_substitutes_key) RegCloseKey(font_substitutes_key);
     if (font_link_key) RegCloseKey(font_link_key);
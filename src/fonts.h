@@ -0,0 +1,177 @@
+// The font keys of the registry, and the change that replaces every font with a single one
+//
+// Requires nob.h and registry.h to be included beforehand, with NOB_STRIP_PREFIX defined.
+// Works on every platform, so changefont and the offline tools make the exact same change.
+// Define FONTS_IMPLEMENTATION in exactly one file before including it, like registry.h.
+
+#ifndef FONTS_H_
+#define FONTS_H_
+
+#define FONTS_REGISTRY_PATH "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts"
+#define FONT_SUBSTITUTES_REGISTRY_PATH "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontSubstitutes"
+#define FONT_LINK_REGISTRY_PATH "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontLink\\SystemLink"
+
+// The font keys of a machine
+typedef struct {
+    Registry_Key fonts;
+    Registry_Key font_substitutes;
+    Registry_Key font_links;
+} Font_Keys;
+
+// Get the length of the font name at the start of the name of a value of the Fonts key
+// Trailing zeroes and bracketed information (e.g. ` (TrueType)`) are not part of the font name.
+size_t font_name_len(const char* name, size_t name_len);
+
+// Derive a font substitute from the name of every font, followed by the existing font substitutes
+// The derived substitutes are REG_TYPE_DELETE, as they need to be deleted to restore the original state.
+// Their names are views into the names of the fonts, which end before the bracketed information, so building the
+// list doesn't allocate anything per font. The existing substitutes refer to the names and data of the keys.
+void font_substitute_list_build(const Font_Keys* keys, Registry_Value_List* result);
+void font_substitute_list_free(Registry_Value_List* list);
+
+// Add the backup of the font keys to a string builder in the form of a .reg file
+// The derived font substitutes are added as deletions, so importing the backup removes them again.
+// Resets the string builder and adds the header
+// Returns true on success, false on failure
+bool font_backup_get_file(const Font_Keys* keys, const Registry_Value_List substitute_list, String_Builder* sb);
+
+// The changes that replace every font with a single one
+typedef struct {
+    // The values of the keys after the change, which the diffs refer to
+    Registry_Value_List modified_fonts;
+    Registry_Value_List modified_font_substitutes;
+    Registry_Value_List modified_font_links;
+    Registry_Key_Diff fonts;
+    Registry_Key_Diff font_substitutes;
+    Registry_Key_Diff font_links;
+} Font_Change;
+
+// Compute the changes that replace every font with the font at font_index
+// The paths of all other fonts are removed, every substitute is set to the chosen font and the font links are deleted.
+// Only the values that actually change end up in the diffs, which refer to the names and data of the keys and substitutes.
+void font_change_compute(const Font_Keys* keys, const Registry_Value_List substitute_list, size_t font_index, Font_Change* change);
+// Add the values that undo a change to a string builder in the form of a .reg file
+// Resets the string builder and adds the header
+// Returns true on success, false on failure
+bool font_change_get_restore_file(const Font_Change* change, String_Builder* sb);
+// Add the values that a change writes to a string builder in the form of a .reg file
+// Resets the string builder and adds the header
+void font_change_get_patch_file(const Font_Change* change, String_Builder* sb);
+// Amount of values that a change writes
+size_t font_change_count(const Font_Change* change);
+void font_change_free(Font_Change* change);
+
+#endif // FONTS_H_
+
+#ifdef FONTS_IMPLEMENTATION
+
+size_t font_name_len(const char* name, size_t name_len) {
+    // Remove trailing zeroes
+    while (name_len > 0 && name[name_len - 1] == '\0') --name_len;
+
+    // Remove trailing bracketed information (e.g. ` (TrueType)`) as it is not part of the font name
+    if (name_len > 0 && name[name_len - 1] == ')') {
+        while (name_len > 0 && name[name_len - 1] != '(')
+            --name_len;
+        if (name_len > 0) --name_len;
+        if (name_len > 0 && name[name_len - 1] == ' ')
+            --name_len;
+    }
+    return name_len;
+}
+
+void font_substitute_list_build(const Font_Keys* keys, Registry_Value_List* result) {
+    const Registry_Value_List font_list = keys->fonts.list;
+    for (size_t i = 0; i < font_list.count; ++i) {
+        Registry_Value val = {
+            // The font name without the bracketed information, which isn't followed by a NUL
+            .name = font_list.items[i].name,
+            .name_len = font_name_len(font_list.items[i].name, font_list.items[i].name_len),
+            .data = NULL,
+            .data_len = 0,
+            // This value needs to be deleted to restore the original state
+            .type = REG_TYPE_DELETE,
+        };
+
+        // Add the value to the font substitute list
+        da_append(result, val);
+    }
+    // Add the existing font substitutes after the ones derived from the fonts
+    da_append_many(result, keys->font_substitutes.list.items, keys->font_substitutes.list.count);
+}
+
+void font_substitute_list_free(Registry_Value_List* list) {
+    da_free(*list);
+    memset(list, 0, sizeof(*list));
+}
+
+bool font_backup_get_file(const Font_Keys* keys, const Registry_Value_List substitute_list, String_Builder* sb) {
+    return reg_key_get_file(FONTS_REGISTRY_PATH, keys->fonts.list, sb)
+        && reg_key_add_to_file(FONT_SUBSTITUTES_REGISTRY_PATH, substitute_list, sb)
+        && reg_key_add_to_file(FONT_LINK_REGISTRY_PATH, keys->font_links.list, sb);
+}
+
+void font_change_compute(const Font_Keys* keys, const Registry_Value_List substitute_list, size_t font_index, Font_Change* change) {
+    memset(change, 0, sizeof(*change));
+    const Registry_Value_List font_list = keys->fonts.list;
+    assert(font_index < font_list.count);
+
+    // Copy the lists that are modified, so they can be compared against the original state
+    da_append_many(&change->modified_fonts, font_list.items, font_list.count);
+    da_append_many(&change->modified_font_substitutes, substitute_list.items, substitute_list.count);
+    da_append_many(&change->modified_font_links, keys->font_links.list.items, keys->font_links.list.count);
+
+    // Remove the font paths (except for the chosen font)
+    for (size_t i = 0; i < change->modified_fonts.count; ++i) {
+        if (i == font_index) continue;
+        change->modified_fonts.items[i].data = "";
+        change->modified_fonts.items[i].data_len = 0;
+    }
+    // Set the font substitute to the chosen font
+    const Registry_Value* chosen = &substitute_list.items[font_index];
+    for (size_t i = 0; i < change->modified_font_substitutes.count; ++i) {
+        if (i == font_index) continue;
+        change->modified_font_substitutes.items[i].data = chosen->name;
+        change->modified_font_substitutes.items[i].data_len = chosen->name_len;
+        change->modified_font_substitutes.items[i].type = REG_TYPE_STRING;
+    }
+    // Delete the font links
+    for (size_t i = 0; i < change->modified_font_links.count; ++i) {
+        change->modified_font_links.items[i].type = REG_TYPE_DELETE;
+    }
+
+    // Only keep the values that actually change
+    reg_key_diff(font_list, change->modified_fonts, &change->fonts);
+    reg_key_diff(keys->font_substitutes.list, change->modified_font_substitutes, &change->font_substitutes);
+    reg_key_diff(keys->font_links.list, change->modified_font_links, &change->font_links);
+}
+
+bool font_change_get_restore_file(const Font_Change* change, String_Builder* sb) {
+    return reg_key_get_file(FONTS_REGISTRY_PATH, change->fonts.restore, sb)
+        && reg_key_add_to_file(FONT_SUBSTITUTES_REGISTRY_PATH, change->font_substitutes.restore, sb)
+        && reg_key_add_to_file(FONT_LINK_REGISTRY_PATH, change->font_links.restore, sb);
+}
+
+void font_change_get_patch_file(const Font_Change* change, String_Builder* sb) {
+    sb->count = 0;
+    sb_append_cstr(sb, "Windows Registry Editor Version 5.00\n");
+    reg_key_diff_add_to_file(FONTS_REGISTRY_PATH, &change->fonts, sb);
+    reg_key_diff_add_to_file(FONT_SUBSTITUTES_REGISTRY_PATH, &change->font_substitutes, sb);
+    reg_key_diff_add_to_file(FONT_LINK_REGISTRY_PATH, &change->font_links, sb);
+}
+
+size_t font_change_count(const Font_Change* change) {
+    return change->fonts.patch.count + change->font_substitutes.patch.count + change->font_links.patch.count;
+}
+
+void font_change_free(Font_Change* change) {
+    da_free(change->modified_fonts);
+    da_free(change->modified_font_substitutes);
+    da_free(change->modified_font_links);
+    reg_key_diff_free(&change->fonts);
+    reg_key_diff_free(&change->font_substitutes);
+    reg_key_diff_free(&change->font_links);
+    memset(change, 0, sizeof(*change));
+}
+
+#endif // FONTS_IMPLEMENTATION
@@ -164,12 +164,20 @@
 #ifndef NOB_H_
 #define NOB_H_
 
+#ifndef NOB_ASSERT
 #define NOB_ASSERT assert
+#endif // NOB_ASSERT
+#ifndef NOB_REALLOC
 #define NOB_REALLOC realloc
+#endif // NOB_REALLOC
+#ifndef NOB_FREE
 #define NOB_FREE free
+#endif // NOB_FREE
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -193,6 +201,7 @@
 #    include <sys/stat.h>
 #    include <unistd.h>
 #    include <fcntl.h>
+#    include <sys/mman.h>
 #endif
 
 #ifdef _WIN32
@@ -221,6 +230,17 @@ extern Nob_Log_Level nob_minimal_log_level;
 
 void nob_log(Nob_Log_Level level, const char *fmt, ...);
 
+// Write the messages of nob_log on a background thread, so threads that log don't wait for stderr or each other
+// Messages below nob_minimal_log_level are still dropped before they are formatted. The others are formatted by the
+// thread that logs them, straight into a slot of a lock-free ring, and the background thread writes them in batches.
+// Their order is kept, and a full ring makes the threads that log wait for the background thread.
+// The queued messages are written when the program exits, so returning from main() doesn't lose any of them.
+// Start and stop it while no other threads are logging, e.g. at the start and end of main().
+// Returns true on success, false if nob_log keeps writing directly
+bool nob_log_async_start(void);
+// Write the queued messages and go back to writing every message directly
+void nob_log_async_stop(void);
+
 // It is an equivalent of shift command from bash. It basically pops an element from
 // the beginning of a sized array.
 #define nob_shift(xs, xs_sz) (NOB_ASSERT((xs_sz) > 0), (xs_sz)--, *(xs)++)
@@ -250,6 +270,31 @@ bool nob_read_entire_dir(const char *parent, Nob_File_Paths *children);
 bool nob_write_entire_file(const char *path, const void *data, size_t size);
 Nob_File_Type nob_get_file_type(const char *path);
 
+// Writes a file in chunks in the background, and only puts it in place once it is complete
+// The chunks go to path with .tmp appended, with overlapped I/O on Windows and pwrite() on a thread of the writer
+// elsewhere, while the caller produces the next chunk. When the writer is closed, the temporary file is flushed to
+// disk once and renamed to path, so path either keeps its old contents or gets all of the new ones.
+typedef struct Nob_File_Writer Nob_File_Writer;
+// Size of the chunks that are written at once
+#ifndef NOB_FILE_WRITER_CHUNK_SIZE
+#define NOB_FILE_WRITER_CHUNK_SIZE (256*1024)
+#endif
+// Returns the writer on success, NULL on failure
+Nob_File_Writer *nob_file_writer_open(const char *path);
+// Append data to the file, which is copied so it doesn't need to outlive the call
+// Returns true on success, false if this or an earlier write failed
+bool nob_file_writer_write(Nob_File_Writer *writer, const void *data, size_t size);
+// Finish writing, flush the file and put it in place, and free the writer
+// Only errors are logged, so the caller can report the file once
+// Returns true on success, false on failure, in which case path is left as it was
+bool nob_file_writer_close(Nob_File_Writer *writer);
+// Stop writing and remove the temporary file, leaving path as it was, and free the writer
+void nob_file_writer_abort(Nob_File_Writer *writer);
+// Write a whole file like nob_write_entire_file(), but through a temporary file that is flushed and renamed to path
+// The data is written on the calling thread, so unlike nob_file_writer_write(), nothing overlaps with the writes.
+// Returns true on success, false on failure, in which case path is left as it was
+bool nob_write_entire_file_atomic(const char *path, const void *data, size_t size);
+
 #define nob_return_defer(value) do { result = (value); goto defer; } while(0)
 
 // Initial capacity of a dynamic array
@@ -405,15 +450,64 @@ bool nob_cmd_run_sync_redirect(Nob_Cmd cmd, Nob_Cmd_Redirect redirect);
 // Run redirected command synchronously and set cmd.count to 0 and close all the opened files
 bool nob_cmd_run_sync_redirect_and_reset(Nob_Cmd *cmd, Nob_Cmd_Redirect redirect);
 
-#ifndef NOB_TEMP_CAPACITY
-#define NOB_TEMP_CAPACITY (8*1024*1024)
-#endif // NOB_TEMP_CAPACITY
+#if defined(_MSC_VER) && !defined(__clang__)
+#    define NOB_THREAD_LOCAL __declspec(thread)
+// The alignment of malloc on Windows, as max_align_t needs C11 mode
+#    define NOB_TEMP_ALIGNMENT (2*sizeof(void*))
+#else
+#    define NOB_THREAD_LOCAL _Thread_local
+#    define NOB_TEMP_ALIGNMENT _Alignof(max_align_t)
+#endif
+
+// The temporary allocator is a chain of chunks per thread, which grows when an allocation doesn't fit.
+// Chunks are kept when the allocator is reset or rewound, so they are reused by the next allocations.
+#ifndef NOB_TEMP_CHUNK_SIZE
+#define NOB_TEMP_CHUNK_SIZE (64*1024)
+#endif // NOB_TEMP_CHUNK_SIZE
 char *nob_temp_strdup(const char *cstr);
 void *nob_temp_alloc(size_t size);
 char *nob_temp_sprintf(const char *format, ...);
 void nob_temp_reset(void);
 size_t nob_temp_save(void);
 void nob_temp_rewind(size_t checkpoint);
+// Highest amount of bytes that the temporary allocator of the current thread has been using at once
+size_t nob_temp_peak(void);
+// Free the chunks of the temporary allocator of the current thread, e.g. before the thread exits
+void nob_temp_free(void);
+// Run the statement or block after it, and rewind the temporary allocator to where it was before it afterwards
+// Leaving the block with break, return or goto skips the rewind.
+#define nob_temp_scope() \
+    for (size_t nob__temp_checkpoint = nob_temp_save(), nob__temp_once = 1; nob__temp_once; nob__temp_once = 0, nob_temp_rewind(nob__temp_checkpoint))
+
+// Pool of worker threads that run tasks, with a deque of tasks per worker
+// A worker runs the newest task of its own deque first, and steals the oldest task of another worker when it runs out.
+// Tasks that are submitted from a worker go to its own deque, tasks from other threads are spread over all deques.
+// The thread that waits for a task group runs tasks as well, so a pool of 0 threads runs every task on that thread.
+typedef struct Nob_Thread_Pool Nob_Thread_Pool;
+// Join handle of a set of tasks
+typedef struct Nob_Task_Group Nob_Task_Group;
+typedef void (*Nob_Task_Func)(void *arg);
+// Called for every index of nob_parallel_for, with the index of the thread in the pool (see nob_thread_pool_worker)
+typedef void (*Nob_Parallel_For_Func)(void *arg, size_t index, size_t worker);
+
+// Amount of processors of the machine, at least 1
+size_t nob_processor_count(void);
+// Start a pool with thread_count worker threads
+// Returns the pool, which has fewer threads if some couldn't be started
+Nob_Thread_Pool *nob_thread_pool_create(size_t thread_count);
+size_t nob_thread_pool_thread_count(const Nob_Thread_Pool *pool);
+// Index of the current thread, from 0 for the worker threads to thread_count for any thread outside of the pool
+size_t nob_thread_pool_worker(const Nob_Thread_Pool *pool);
+// Stop the worker threads once every submitted task has run, and free the pool
+void nob_thread_pool_destroy(Nob_Thread_Pool *pool);
+Nob_Task_Group *nob_task_group_create(void);
+// Queue a task that runs func(arg) as part of a group
+void nob_thread_pool_submit(Nob_Thread_Pool *pool, Nob_Task_Group *group, Nob_Task_Func func, void *arg);
+// Run tasks until every task of a group (including the ones that its tasks submitted) has finished, and free the group
+void nob_task_group_wait(Nob_Thread_Pool *pool, Nob_Task_Group *group);
+// Call body for every index in [begin, end) on the threads of a pool, and wait for all of them
+// The range is split in halves until the parts have at most grain indices, so idle workers can steal the other halves.
+void nob_parallel_for(Nob_Thread_Pool *pool, size_t begin, size_t end, size_t grain, Nob_Parallel_For_Func body, void *arg);
 
 // Given any path returns the last part of that path.
 // "/path/to/a/file.c" -> "file.c"; "/path/to/a/directory" -> "directory"
@@ -483,6 +577,21 @@ Nob_String_View nob_sv_from_parts(const char *data, size_t count);
 // nob_sb_to_sv() enables you to just view Nob_String_Builder as Nob_String_View
 #define nob_sb_to_sv(sb) nob_sv_from_parts((sb).items, (sb).count)
 
+// How a mapped file is going to be read, so the system knows whether to read ahead
+typedef enum {
+    NOB_MAP_DEFAULT,
+    // From the start to the end, so the pages ahead are read early and the pages behind can be dropped early
+    NOB_MAP_SEQUENTIAL,
+    // In no particular order, so reading ahead would only waste I/O and memory
+    NOB_MAP_RANDOM,
+} Nob_Map_Access;
+
+// Map a whole file into memory as a read-only view, instead of copying it like nob_read_entire_file()
+// The view stays valid until nob_unmap_file(), and an empty file is an empty view.
+// Returns true on success, false on failure
+bool nob_map_file(const char *path, Nob_String_View *view, Nob_Map_Access access);
+void nob_unmap_file(Nob_String_View view);
+
 // printf macros for String_View
 #ifndef SV_Fmt
 #define SV_Fmt "%.*s"
@@ -638,8 +747,22 @@ void nob__go_rebuild_urself(const char *source_path, int argc, char **argv)
     exit(0);
 }
 
-static size_t nob_temp_size = 0;
-static char nob_temp[NOB_TEMP_CAPACITY] = {0};
+typedef struct Nob_Temp_Chunk {
+    struct Nob_Temp_Chunk *prev;
+    struct Nob_Temp_Chunk *next;
+    // Position of the first byte of this chunk, counted over all chunks before it
+    size_t base;
+    size_t capacity;
+    char data[];
+} Nob_Temp_Chunk;
+// The allocations are aligned from the start of the data, so it needs to be aligned like the chunk itself
+typedef char nob__temp_chunk_data_is_aligned[offsetof(Nob_Temp_Chunk, data) % NOB_TEMP_ALIGNMENT == 0 ? 1 : -1];
+
+// The temporary allocator of a thread, of which the position is what nob_temp_save() returns
+static NOB_THREAD_LOCAL Nob_Temp_Chunk *nob_temp_first = NULL;
+static NOB_THREAD_LOCAL Nob_Temp_Chunk *nob_temp_chunk = NULL;
+static NOB_THREAD_LOCAL size_t nob_temp_size = 0;
+static NOB_THREAD_LOCAL size_t nob_temp_peak_size = 0;
 
 bool nob_mkdir_if_not_exists(const char *path)
 {
@@ -1047,10 +1170,18 @@ bool nob_cmd_run_sync_redirect_and_reset(Nob_Cmd *cmd, Nob_Cmd_Redirect redirect
     return p;
 }
 
+static bool nob__log_async_push(Nob_Log_Level level, const char *fmt, va_list args);
+
 void nob_log(Nob_Log_Level level, const char *fmt, ...)
 {
     if (level < nob_minimal_log_level) return;
 
+    va_list args;
+    va_start(args, fmt);
+    bool queued = nob__log_async_push(level, fmt, args);
+    va_end(args);
+    if (queued) return;
+
     switch (level) {
     case NOB_INFO:
         fprintf(stderr, "[INFO] ");
@@ -1066,7 +1197,6 @@ void nob_log(Nob_Log_Level level, const char *fmt, ...)
         NOB_UNREACHABLE("nob_log");
     }
 
-    va_list args;
     va_start(args, fmt);
     vfprintf(stderr, fmt, args);
     va_end(args);
@@ -1237,17 +1367,57 @@ char *nob_temp_strdup(const char *cstr)
 {
     size_t n = strlen(cstr);
     char *result = nob_temp_alloc(n + 1);
-    NOB_ASSERT(result != NULL && "Increase NOB_TEMP_CAPACITY");
+    NOB_ASSERT(result != NULL && "Buy more RAM lol");
     memcpy(result, cstr, n);
     result[n] = '\0';
     return result;
 }
 
+// Create a chunk that can hold at least size bytes
+static Nob_Temp_Chunk *nob__temp_chunk_new(size_t size)
+{
+    size_t capacity = size > NOB_TEMP_CHUNK_SIZE ? size : NOB_TEMP_CHUNK_SIZE;
+    if (capacity > SIZE_MAX - sizeof(Nob_Temp_Chunk)) return NULL;
+    Nob_Temp_Chunk *chunk = NOB_REALLOC(NULL, sizeof(*chunk) + capacity);
+    if (chunk == NULL) return NULL;
+    chunk->prev = NULL;
+    chunk->next = NULL;
+    chunk->base = 0;
+    chunk->capacity = capacity;
+    return chunk;
+}
+
 void *nob_temp_alloc(size_t size)
 {
-    if (nob_temp_size + size > NOB_TEMP_CAPACITY) return NULL;
-    void *result = &nob_temp[nob_temp_size];
+    // Keep allocations aligned for any type, like the chunks that malloc returns
+    if (size > SIZE_MAX - (NOB_TEMP_ALIGNMENT - 1)) return NULL;
+    size = (size + NOB_TEMP_ALIGNMENT - 1) & ~(NOB_TEMP_ALIGNMENT - 1);
+    if (nob_temp_chunk == NULL) {
+        nob_temp_first = nob_temp_chunk = nob__temp_chunk_new(size);
+        if (nob_temp_chunk == NULL) return NULL;
+    }
+
+    // The position never goes past the end of the current chunk, so this can't overflow
+    if (size > nob_temp_chunk->base + nob_temp_chunk->capacity - nob_temp_size) {
+        // Move on to the next chunk, or put a new one before it when it is too small
+        Nob_Temp_Chunk *next = nob_temp_chunk->next;
+        if (next == NULL || next->capacity < size) {
+            next = nob__temp_chunk_new(size);
+            if (next == NULL) return NULL;
+            next->prev = nob_temp_chunk;
+            next->next = nob_temp_chunk->next;
+            if (next->next != NULL) next->next->prev = next;
+            nob_temp_chunk->next = next;
+        }
+        // The rest of the current chunk is skipped
+        next->base = nob_temp_chunk->base + nob_temp_chunk->capacity;
+        nob_temp_chunk = next;
+        nob_temp_size = next->base;
+    }
+
+    void *result = &nob_temp_chunk->data[nob_temp_size - nob_temp_chunk->base];
     nob_temp_size += size;
+    if (nob_temp_size > nob_temp_peak_size) nob_temp_peak_size = nob_temp_size;
     return result;
 }
 
@@ -1260,8 +1430,7 @@ char *nob_temp_sprintf(const char *format, ...)
 
     NOB_ASSERT(n >= 0);
     char *result = nob_temp_alloc(n + 1);
-    NOB_ASSERT(result != NULL && "Extend the size of the temporary allocator");
-    // TODO: use proper arenas for the temporary allocator;
+    NOB_ASSERT(result != NULL && "Buy more RAM lol");
     va_start(args, format);
     vsnprintf(result, n + 1, format, args);
     va_end(args);
@@ -1271,6 +1440,7 @@ char *nob_temp_sprintf(const char *format, ...)
 
 void nob_temp_reset(void)
 {
+    nob_temp_chunk = nob_temp_first;
     nob_temp_size = 0;
 }
 
@@ -1281,13 +1451,873 @@ size_t nob_temp_save(void)
 
 void nob_temp_rewind(size_t checkpoint)
 {
+    // Go back to the chunk that the checkpoint is in
+    while (nob_temp_chunk != NULL && nob_temp_chunk->prev != NULL && checkpoint < nob_temp_chunk->base) {
+        nob_temp_chunk = nob_temp_chunk->prev;
+    }
     nob_temp_size = checkpoint;
 }
 
+size_t nob_temp_peak(void)
+{
+    return nob_temp_peak_size;
+}
+
+void nob_temp_free(void)
+{
+    while (nob_temp_first != NULL) {
+        Nob_Temp_Chunk *next = nob_temp_first->next;
+        NOB_FREE(nob_temp_first);
+        nob_temp_first = next;
+    }
+    nob_temp_chunk = NULL;
+    nob_temp_size = 0;
+}
+
+#ifndef _WIN32
+#    include <pthread.h>
+#    include <sched.h>
+#endif
+
+#ifdef _WIN32
+typedef volatile LONG Nob__Atomic;
+#    define nob__atomic_inc(atomic) InterlockedIncrement(atomic)
+#    define nob__atomic_dec(atomic) InterlockedDecrement(atomic)
+#    define nob__atomic_load(atomic) InterlockedCompareExchange((atomic), 0, 0)
+#    define nob__atomic_store(atomic, value) InterlockedExchange((atomic), (value))
+#    define nob__atomic_exchange(atomic, value) InterlockedExchange((atomic), (value))
+#    define nob__atomic_cas(atomic, expected, desired) (InterlockedCompareExchange((atomic), (desired), (expected)) == (expected))
+typedef CRITICAL_SECTION Nob__Lock;
+#    define nob__lock_init(lock) InitializeCriticalSection(lock)
+#    define nob__lock(lock) EnterCriticalSection(lock)
+#    define nob__unlock(lock) LeaveCriticalSection(lock)
+#    define nob__lock_destroy(lock) DeleteCriticalSection(lock)
+// Counting semaphore that threads sleep on
+typedef HANDLE Nob__Sema;
+#    define nob__sema_init(sema) (*(sema) = CreateSemaphoreA(NULL, 0, LONG_MAX, NULL), NOB_ASSERT(*(sema) != NULL))
+#    define nob__sema_post(sema) ReleaseSemaphore(*(sema), 1, NULL)
+#    define nob__sema_wait(sema) WaitForSingleObject(*(sema), INFINITE)
+#    define nob__sema_destroy(sema) CloseHandle(*(sema))
+#else
+typedef long Nob__Atomic;
+#    define nob__atomic_inc(atomic) __atomic_add_fetch((atomic), 1, __ATOMIC_ACQ_REL)
+#    define nob__atomic_dec(atomic) __atomic_sub_fetch((atomic), 1, __ATOMIC_ACQ_REL)
+#    define nob__atomic_load(atomic) __atomic_load_n((atomic), __ATOMIC_ACQUIRE)
+#    define nob__atomic_store(atomic, value) __atomic_store_n((atomic), (value), __ATOMIC_RELEASE)
+#    define nob__atomic_exchange(atomic, value) __atomic_exchange_n((atomic), (value), __ATOMIC_SEQ_CST)
+#    define nob__atomic_cas(atomic, expected, desired) \
+    __atomic_compare_exchange_n((atomic), &(long){(expected)}, (desired), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)
+typedef pthread_mutex_t Nob__Lock;
+#    define nob__lock_init(lock) pthread_mutex_init((lock), NULL)
+#    define nob__lock(lock) pthread_mutex_lock(lock)
+#    define nob__unlock(lock) pthread_mutex_unlock(lock)
+#    define nob__lock_destroy(lock) pthread_mutex_destroy(lock)
+// Counting semaphore that threads sleep on
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t count;
+} Nob__Sema;
+
+static void nob__sema_init(Nob__Sema *sema)
+{
+    pthread_mutex_init(&sema->lock, NULL);
+    pthread_cond_init(&sema->cond, NULL);
+    sema->count = 0;
+}
+
+static void nob__sema_post(Nob__Sema *sema)
+{
+    pthread_mutex_lock(&sema->lock);
+    sema->count += 1;
+    pthread_cond_signal(&sema->cond);
+    pthread_mutex_unlock(&sema->lock);
+}
+
+static void nob__sema_wait(Nob__Sema *sema)
+{
+    pthread_mutex_lock(&sema->lock);
+    while (sema->count == 0) pthread_cond_wait(&sema->cond, &sema->lock);
+    sema->count -= 1;
+    pthread_mutex_unlock(&sema->lock);
+}
+
+static void nob__sema_destroy(Nob__Sema *sema)
+{
+    pthread_cond_destroy(&sema->cond);
+    pthread_mutex_destroy(&sema->lock);
+}
+#endif // _WIN32
+
+struct Nob_Task_Group {
+    // Tasks that were submitted but haven't finished yet
+    Nob__Atomic pending;
+    // Posted when the last task finishes
+    Nob__Sema done;
+};
+
+typedef struct {
+    Nob_Task_Func func;
+    void *arg;
+    Nob_Task_Group *group;
+} Nob__Task;
+
+// Ring buffer of tasks, of which the owner takes the newest and thieves take the oldest
+typedef struct {
+    Nob__Lock lock;
+    Nob__Task *items;
+    size_t head;
+    size_t count;
+    size_t capacity;
+} Nob__Deque;
+
+struct Nob_Thread_Pool {
+#ifdef _WIN32
+    HANDLE *threads;
+#else
+    pthread_t *threads;
+#endif
+    size_t thread_count;
+    // One deque per worker thread, plus one for the threads outside of the pool
+    Nob__Deque *deques;
+    // Posted once for every submitted task, which wakes up a sleeping worker
+    Nob__Sema work;
+    // Spreads the tasks of threads outside of the pool over the deques
+    Nob__Atomic next_deque;
+    Nob__Atomic stopping;
+};
+
+typedef struct {
+    Nob_Thread_Pool *pool;
+    size_t index;
+} Nob__Worker_Start;
+
+// The pool that the current thread is a worker of, and its index
+static NOB_THREAD_LOCAL Nob_Thread_Pool *nob__pool_current = NULL;
+static NOB_THREAD_LOCAL size_t nob__pool_worker = 0;
+
+size_t nob_processor_count(void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t) count : 1;
+#endif
+}
+
+static void nob__deque_push(Nob__Deque *deque, Nob__Task task)
+{
+    nob__lock(&deque->lock);
+    if (deque->count >= deque->capacity) {
+        // Unwrap the ring into the bigger buffer
+        size_t capacity = deque->capacity == 0 ? 64 : deque->capacity*2;
+        Nob__Task *items = NOB_REALLOC(NULL, capacity*sizeof(*items));
+        NOB_ASSERT(items != NULL && "Buy more RAM lol");
+        for (size_t i = 0; i < deque->count; ++i) items[i] = deque->items[(deque->head + i) % deque->capacity];
+        NOB_FREE(deque->items);
+        deque->items = items;
+        deque->head = 0;
+        deque->capacity = capacity;
+    }
+    deque->items[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count += 1;
+    nob__unlock(&deque->lock);
+}
+
+// Take the newest task (bottom) or the oldest task (top) of a deque
+// Returns true if there was a task, false otherwise
+static bool nob__deque_pop(Nob__Deque *deque, bool bottom, Nob__Task *task)
+{
+    nob__lock(&deque->lock);
+    bool result = deque->count > 0;
+    if (result) {
+        if (bottom) {
+            *task = deque->items[(deque->head + deque->count - 1) % deque->capacity];
+        } else {
+            *task = deque->items[deque->head];
+            deque->head = (deque->head + 1) % deque->capacity;
+        }
+        deque->count -= 1;
+    }
+    nob__unlock(&deque->lock);
+    return result;
+}
+
+// Take a task from the own deque of a thread, or steal one from the others
+// Returns true if there was a task, false otherwise
+static bool nob__pool_find_task(Nob_Thread_Pool *pool, size_t own, Nob__Task *task)
+{
+    size_t deque_count = pool->thread_count + 1;
+    if (nob__deque_pop(&pool->deques[own], true, task)) return true;
+    for (size_t i = 1; i < deque_count; ++i) {
+        if (nob__deque_pop(&pool->deques[(own + i) % deque_count], false, task)) return true;
+    }
+    return false;
+}
+
+static void nob__pool_run_task(Nob__Task task)
+{
+    task.func(task.arg);
+    if (nob__atomic_dec(&task.group->pending) == 0) nob__sema_post(&task.group->done);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI nob__pool_worker_main(LPVOID arg)
+#else
+static void *nob__pool_worker_main(void *arg)
+#endif
+{
+    Nob__Worker_Start start = *(Nob__Worker_Start*) arg;
+    NOB_FREE(arg);
+    Nob_Thread_Pool *pool = start.pool;
+    nob__pool_current = pool;
+    nob__pool_worker = start.index;
+
+    for (;;) {
+        // Every submitted task posts once, so this only sleeps when the deques are empty
+        // Sleeping first also makes sure that the pool is completely set up before the worker looks at it.
+        nob__sema_wait(&pool->work);
+        Nob__Task task;
+        while (nob__pool_find_task(pool, start.index, &task)) nob__pool_run_task(task);
+        if (nob__atomic_load(&pool->stopping)) break;
+    }
+    // Every thread has its own temporary allocator
+    nob_temp_free();
+    return 0;
+}
+
+Nob_Thread_Pool *nob_thread_pool_create(size_t thread_count)
+{
+    Nob_Thread_Pool *pool = NOB_REALLOC(NULL, sizeof(*pool));
+    NOB_ASSERT(pool != NULL && "Buy more RAM lol");
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = NOB_REALLOC(NULL, (thread_count > 0 ? thread_count : 1)*sizeof(*pool->threads));
+    pool->deques = NOB_REALLOC(NULL, (thread_count + 1)*sizeof(*pool->deques));
+    NOB_ASSERT(pool->threads != NULL && pool->deques != NULL && "Buy more RAM lol");
+    memset(pool->deques, 0, (thread_count + 1)*sizeof(*pool->deques));
+    for (size_t i = 0; i < thread_count + 1; ++i) nob__lock_init(&pool->deques[i].lock);
+    nob__sema_init(&pool->work);
+
+    size_t started = 0;
+    for (; started < thread_count; ++started) {
+        Nob__Worker_Start *start = NOB_REALLOC(NULL, sizeof(*start));
+        NOB_ASSERT(start != NULL && "Buy more RAM lol");
+        start->pool = pool;
+        start->index = started;
+#ifdef _WIN32
+        pool->threads[started] = CreateThread(NULL, 0, nob__pool_worker_main, start, 0, NULL);
+        if (pool->threads[started] == NULL) {
+            nob_log(NOB_ERROR, "Could not start a worker thread: %s", nob_win32_error_message(GetLastError()));
+            NOB_FREE(start);
+            break;
+        }
+#else
+        int error = pthread_create(&pool->threads[started], NULL, nob__pool_worker_main, start);
+        if (error != 0) {
+            nob_log(NOB_ERROR, "Could not start a worker thread: %s", strerror(error));
+            NOB_FREE(start);
+            break;
+        }
+#endif
+    }
+    // The deque after the started threads is the one of the outside threads, the rest isn't used
+    for (size_t i = started + 1; i < thread_count + 1; ++i) nob__lock_destroy(&pool->deques[i].lock);
+    pool->thread_count = started;
+    return pool;
+}
+
+size_t nob_thread_pool_thread_count(const Nob_Thread_Pool *pool)
+{
+    return pool->thread_count;
+}
+
+size_t nob_thread_pool_worker(const Nob_Thread_Pool *pool)
+{
+    return nob__pool_current == pool ? nob__pool_worker : pool->thread_count;
+}
+
+void nob_thread_pool_destroy(Nob_Thread_Pool *pool)
+{
+    if (pool == NULL) return;
+    nob__atomic_inc(&pool->stopping);
+    for (size_t i = 0; i < pool->thread_count; ++i) nob__sema_post(&pool->work);
+    for (size_t i = 0; i < pool->thread_count; ++i) {
+#ifdef _WIN32
+        WaitForSingleObject(pool->threads[i], INFINITE);
+        CloseHandle(pool->threads[i]);
+#else
+        pthread_join(pool->threads[i], NULL);
+#endif
+    }
+    for (size_t i = 0; i < pool->thread_count + 1; ++i) {
+        nob__lock_destroy(&pool->deques[i].lock);
+        NOB_FREE(pool->deques[i].items);
+    }
+    nob__sema_destroy(&pool->work);
+    NOB_FREE(pool->deques);
+    NOB_FREE(pool->threads);
+    NOB_FREE(pool);
+}
+
+Nob_Task_Group *nob_task_group_create(void)
+{
+    Nob_Task_Group *group = NOB_REALLOC(NULL, sizeof(*group));
+    NOB_ASSERT(group != NULL && "Buy more RAM lol");
+    group->pending = 0;
+    nob__sema_init(&group->done);
+    return group;
+}
+
+void nob_thread_pool_submit(Nob_Thread_Pool *pool, Nob_Task_Group *group, Nob_Task_Func func, void *arg)
+{
+    nob__atomic_inc(&group->pending);
+    Nob__Task task = {.func = func, .arg = arg, .group = group};
+    size_t deque = nob_thread_pool_worker(pool);
+    if (deque == pool->thread_count && pool->thread_count > 0) {
+        deque = (size_t) nob__atomic_inc(&pool->next_deque) % pool->thread_count;
+    }
+    nob__deque_push(&pool->deques[deque], task);
+    nob__sema_post(&pool->work);
+}
+
+void nob_task_group_wait(Nob_Thread_Pool *pool, Nob_Task_Group *group)
+{
+    size_t own = nob_thread_pool_worker(pool);
+    bool woken = false;
+    while (!woken && nob__atomic_load(&group->pending) > 0) {
+        Nob__Task task;
+        if (nob__pool_find_task(pool, own, &task)) {
+            nob__pool_run_task(task);
+        } else {
+            // The other tasks are running, the last one to finish wakes this thread up
+            nob__sema_wait(&group->done);
+            woken = true;
+        }
+    }
+    // The last task posts right after it finishes, so the group can only be freed once that happened
+    if (!woken) nob__sema_wait(&group->done);
+    nob__sema_destroy(&group->done);
+    NOB_FREE(group);
+}
+
+typedef struct {
+    Nob_Thread_Pool *pool;
+    Nob_Task_Group *group;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    Nob_Parallel_For_Func body;
+    void *arg;
+} Nob__Range;
+
+static void nob__parallel_for_task(void *arg)
+{
+    Nob__Range *range = arg;
+    // Leave the upper halves to be stolen, and keep the lowest part
+    while (range->end - range->begin > range->grain) {
+        Nob__Range *upper = NOB_REALLOC(NULL, sizeof(*upper));
+        NOB_ASSERT(upper != NULL && "Buy more RAM lol");
+        *upper = *range;
+        upper->begin = range->begin + (range->end - range->begin)/2;
+        range->end = upper->begin;
+        nob_thread_pool_submit(range->pool, range->group, nob__parallel_for_task, upper);
+    }
+    size_t worker = nob_thread_pool_worker(range->pool);
+    for (size_t i = range->begin; i < range->end; ++i) range->body(range->arg, i, worker);
+    NOB_FREE(range);
+}
+
+void nob_parallel_for(Nob_Thread_Pool *pool, size_t begin, size_t end, size_t grain, Nob_Parallel_For_Func body, void *arg)
+{
+    if (begin >= end) return;
+    Nob__Range *range = NOB_REALLOC(NULL, sizeof(*range));
+    NOB_ASSERT(range != NULL && "Buy more RAM lol");
+    *range = (Nob__Range) {
+        .pool = pool,
+        .group = nob_task_group_create(),
+        .begin = begin,
+        .end = end,
+        .grain = grain > 0 ? grain : 1,
+        .body = body,
+        .arg = arg,
+    };
+    Nob_Task_Group *group = range->group;
+    nob_thread_pool_submit(pool, group, nob__parallel_for_task, range);
+    nob_task_group_wait(pool, group);
+}
+
+// Amount of messages that the ring of nob_log_async_start holds, which needs to be a power of 2
+#ifndef NOB_LOG_ASYNC_CAPACITY
+#define NOB_LOG_ASYNC_CAPACITY 1024
+#endif
+// Messages that don't fit into a slot get their own allocation
+#define NOB__LOG_SLOT_TEXT 240
+// The writer thread writes its batch of messages once it gets this big, or once the ring is empty
+#define NOB__LOG_BATCH_SIZE (64*1024)
+
+typedef struct {
+    // The position of the message when it can be written, and the position plus one once it is ready to be written
+    Nob__Atomic sequence;
+    size_t len;
+    char *heap;
+    char text[NOB__LOG_SLOT_TEXT];
+} Nob__Log_Slot;
+
+typedef struct {
+    Nob__Log_Slot *slots;
+    // Position of the next message that a thread can take
+    Nob__Atomic enqueue;
+    // Position of the next message that the writer thread writes, which only it uses
+    long dequeue;
+    // Set by the writer thread before it sleeps, and cleared by the thread that wakes it up
+    Nob__Atomic sleeping;
+    Nob__Atomic stopping;
+    Nob__Sema wake;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+} Nob__Log_Async;
+
+static Nob__Log_Async *nob__log_async = NULL;
+
+static void nob__log_async_wake(Nob__Log_Async *async)
+{
+    if (nob__atomic_exchange(&async->sleeping, 0) == 1) nob__sema_post(&async->wake);
+}
+
+// Returns true if the ring holds a message that is ready to be written, false otherwise
+static bool nob__log_async_ready(Nob__Log_Async *async)
+{
+    Nob__Log_Slot *slot = &async->slots[(unsigned long) async->dequeue % NOB_LOG_ASYNC_CAPACITY];
+    return nob__atomic_load(&slot->sequence) == (long) ((unsigned long) async->dequeue + 1);
+}
+
+static bool nob__log_async_push(Nob_Log_Level level, const char *fmt, va_list args)
+{
+    Nob__Log_Async *async = nob__log_async;
+    if (async == NULL || level < NOB_INFO || level > NOB_ERROR) return false;
+    const char *prefix = level == NOB_INFO ? "[INFO] " : level == NOB_WARNING ? "[WARNING] " : "[ERROR] ";
+
+    // Take the next slot, once the writer thread is done with it
+    long pos = nob__atomic_load(&async->enqueue);
+    Nob__Log_Slot *slot;
+    for (;;) {
+        slot = &async->slots[(unsigned long) pos % NOB_LOG_ASYNC_CAPACITY];
+        long diff = (long) ((unsigned long) nob__atomic_load(&slot->sequence) - (unsigned long) pos);
+        if (diff == 0) {
+            if (nob__atomic_cas(&async->enqueue, pos, (long) ((unsigned long) pos + 1))) break;
+        } else if (diff < 0) {
+            // The ring is full
+            nob__log_async_wake(async);
+#ifdef _WIN32
+            Sleep(0);
+#else
+            sched_yield();
+#endif
+        }
+        pos = nob__atomic_load(&async->enqueue);
+    }
+
+    // Format the message into the slot, as its arguments may not outlive this call
+    va_list copy;
+    va_copy(copy, args);
+    size_t prefix_len = strlen(prefix);
+    memcpy(slot->text, prefix, prefix_len);
+    int n = vsnprintf(slot->text + prefix_len, sizeof(slot->text) - prefix_len, fmt, args);
+    size_t len = prefix_len + (n > 0 ? (size_t) n : 0);
+    slot->heap = NULL;
+    if (len + 1 > sizeof(slot->text)) {
+        slot->heap = NOB_REALLOC(NULL, len + 2);
+        NOB_ASSERT(slot->heap != NULL && "Buy more RAM lol");
+        memcpy(slot->heap, prefix, prefix_len);
+        vsnprintf(slot->heap + prefix_len, len + 2 - prefix_len, fmt, copy);
+    }
+    va_end(copy);
+    char *text = slot->heap != NULL ? slot->heap : slot->text;
+    text[len] = '\n';
+    slot->len = len + 1;
+
+    nob__atomic_store(&slot->sequence, (long) ((unsigned long) pos + 1));
+    nob__log_async_wake(async);
+    return true;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI nob__log_async_main(LPVOID arg)
+#else
+static void *nob__log_async_main(void *arg)
+#endif
+{
+    Nob__Log_Async *async = arg;
+    Nob_String_Builder batch = {0};
+    for (;;) {
+        // Everything that was logged before stopping is in the ring at this point
+        bool stopping = nob__atomic_load(&async->stopping);
+        while (nob__log_async_ready(async)) {
+            Nob__Log_Slot *slot = &async->slots[(unsigned long) async->dequeue % NOB_LOG_ASYNC_CAPACITY];
+            nob_sb_append_buf(&batch, slot->heap != NULL ? slot->heap : slot->text, slot->len);
+            NOB_FREE(slot->heap);
+            // Hand the slot back to the threads that log
+            nob__atomic_store(&slot->sequence, (long) ((unsigned long) async->dequeue + NOB_LOG_ASYNC_CAPACITY));
+            async->dequeue = (long) ((unsigned long) async->dequeue + 1);
+            if (batch.count >= NOB__LOG_BATCH_SIZE) {
+                fwrite(batch.items, 1, batch.count, stderr);
+                batch.count = 0;
+            }
+        }
+        if (batch.count > 0) {
+            fwrite(batch.items, 1, batch.count, stderr);
+            batch.count = 0;
+        }
+        if (stopping) break;
+
+        // Sleep until a message is ready, unless one got ready in the meantime
+        nob__atomic_exchange(&async->sleeping, 1);
+        if ((nob__log_async_ready(async) || nob__atomic_load(&async->stopping))
+            && nob__atomic_exchange(&async->sleeping, 0) == 1) continue;
+        // Otherwise the thread that cleared it posts, or has already posted
+        nob__sema_wait(&async->wake);
+    }
+    nob_sb_free(batch);
+    return 0;
+}
+
+bool nob_log_async_start(void)
+{
+    static bool exit_hook = false;
+    if (nob__log_async != NULL) return true;
+
+    Nob__Log_Async *async = NOB_REALLOC(NULL, sizeof(*async));
+    NOB_ASSERT(async != NULL && "Buy more RAM lol");
+    memset(async, 0, sizeof(*async));
+    async->slots = NOB_REALLOC(NULL, NOB_LOG_ASYNC_CAPACITY*sizeof(*async->slots));
+    NOB_ASSERT(async->slots != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < NOB_LOG_ASYNC_CAPACITY; ++i) async->slots[i].sequence = (long) i;
+    nob__sema_init(&async->wake);
+
+#ifdef _WIN32
+    async->thread = CreateThread(NULL, 0, nob__log_async_main, async, 0, NULL);
+    bool started = async->thread != NULL;
+    if (!started) nob_log(NOB_ERROR, "Could not start the log thread: %s", nob_win32_error_message(GetLastError()));
+#else
+    int error = pthread_create(&async->thread, NULL, nob__log_async_main, async);
+    bool started = error == 0;
+    if (!started) nob_log(NOB_ERROR, "Could not start the log thread: %s", strerror(error));
+#endif
+    if (!started) {
+        nob__sema_destroy(&async->wake);
+        NOB_FREE(async->slots);
+        NOB_FREE(async);
+        return false;
+    }
+    nob__log_async = async;
+    // Write the queued messages when main() returns or exit() is called
+    if (!exit_hook) exit_hook = atexit(nob_log_async_stop) == 0;
+    return true;
+}
+
+void nob_log_async_stop(void)
+{
+    Nob__Log_Async *async = nob__log_async;
+    if (async == NULL) return;
+    nob__atomic_store(&async->stopping, 1);
+    nob__log_async_wake(async);
+#ifdef _WIN32
+    WaitForSingleObject(async->thread, INFINITE);
+    CloseHandle(async->thread);
+#else
+    pthread_join(async->thread, NULL);
+#endif
+    nob__log_async = NULL;
+    nob__sema_destroy(&async->wake);
+    NOB_FREE(async->slots);
+    NOB_FREE(async);
+}
+
+struct Nob_File_Writer {
+    char *path;
+    char *temp_path;
+    Nob_Fd fd;
+    // Offset of the next chunk in the file
+    uint64_t offset;
+    // The chunk that is being filled, and the chunk that may still be written
+    Nob_String_Builder chunks[2];
+    size_t current;
+    // A write was started and hasn't been waited for yet
+    bool pending;
+    size_t pending_size;
+    bool failed;
+#ifdef _WIN32
+    OVERLAPPED overlapped;
+#else
+    // Without a thread, the chunks are written right away
+    bool background;
+    pthread_t thread;
+    // Posted when a write is started, or when the thread needs to stop
+    Nob__Sema submitted;
+    // Posted when a write is done
+    Nob__Sema written;
+    const char *job_data;
+    int job_error;
+    bool stopping;
+#endif // _WIN32
+};
+
+#ifndef _WIN32
+// Returns 0 on success, the errno of the write that failed otherwise
+static int nob__pwrite_all(int fd, const char *data, size_t size, uint64_t offset)
+{
+    while (size > 0) {
+        ssize_t n = pwrite(fd, data, size, (off_t) offset);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+static void *nob__file_writer_main(void *arg)
+{
+    Nob_File_Writer *writer = arg;
+    for (;;) {
+        nob__sema_wait(&writer->submitted);
+        if (writer->stopping) break;
+        writer->job_error = nob__pwrite_all(writer->fd, writer->job_data, writer->pending_size, writer->offset - writer->pending_size);
+        nob__sema_post(&writer->written);
+    }
+    return NULL;
+}
+#endif // _WIN32
+
+static Nob_File_Writer *nob__file_writer_open(const char *path, bool background)
+{
+    Nob_File_Writer *writer = NOB_REALLOC(NULL, sizeof(*writer));
+    NOB_ASSERT(writer != NULL && "Buy more RAM lol");
+    memset(writer, 0, sizeof(*writer));
+    // Keep both paths, as the one of the caller may not live long enough
+    size_t path_len = strlen(path);
+    writer->path = NOB_REALLOC(NULL, 2*path_len + sizeof(".tmp") + 1);
+    NOB_ASSERT(writer->path != NULL && "Buy more RAM lol");
+    memcpy(writer->path, path, path_len + 1);
+    writer->temp_path = writer->path + path_len + 1;
+    memcpy(writer->temp_path, path, path_len);
+    memcpy(writer->temp_path + path_len, ".tmp", sizeof(".tmp"));
+
+#ifdef _WIN32
+    NOB_UNUSED(background);
+    writer->fd = CreateFileA(writer->temp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+    if (writer->fd == INVALID_HANDLE_VALUE) {
+        nob_log(NOB_ERROR, "Could not open file %s for writing: %s", writer->temp_path, nob_win32_error_message(GetLastError()));
+        NOB_FREE(writer->path);
+        NOB_FREE(writer);
+        return NULL;
+    }
+    // Manual reset, like GetOverlappedResult expects
+    writer->overlapped.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    NOB_ASSERT(writer->overlapped.hEvent != NULL);
+#else
+    writer->fd = open(writer->temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (writer->fd < 0) {
+        nob_log(NOB_ERROR, "Could not open file %s for writing: %s", writer->temp_path, strerror(errno));
+        NOB_FREE(writer->path);
+        NOB_FREE(writer);
+        return NULL;
+    }
+    if (background) {
+        nob__sema_init(&writer->submitted);
+        nob__sema_init(&writer->written);
+        // Without the thread, the chunks are still written, just not in the background
+        writer->background = pthread_create(&writer->thread, NULL, nob__file_writer_main, writer) == 0;
+        if (!writer->background) {
+            nob__sema_destroy(&writer->submitted);
+            nob__sema_destroy(&writer->written);
+        }
+    }
+#endif // _WIN32
+    return writer;
+}
+
+// Start writing data at the end of the file, which needs to stay valid until nob__file_writer_wait()
+static void nob__file_writer_start(Nob_File_Writer *writer, const void *data, size_t size)
+{
+    writer->pending = true;
+    writer->pending_size = size;
+#ifdef _WIN32
+    HANDLE event = writer->overlapped.hEvent;
+    memset(&writer->overlapped, 0, sizeof(writer->overlapped));
+    writer->overlapped.hEvent = event;
+    writer->overlapped.Offset = (DWORD) writer->offset;
+    writer->overlapped.OffsetHigh = (DWORD) (writer->offset >> 32);
+    writer->offset += size;
+    if (!WriteFile(writer->fd, data, (DWORD) size, NULL, &writer->overlapped) && GetLastError() != ERROR_IO_PENDING) {
+        nob_log(NOB_ERROR, "Could not write into file %s: %s", writer->temp_path, nob_win32_error_message(GetLastError()));
+        writer->pending = false;
+        writer->failed = true;
+    }
+#else
+    writer->offset += size;
+    writer->job_data = data;
+    if (writer->background) {
+        nob__sema_post(&writer->submitted);
+    } else {
+        writer->job_error = nob__pwrite_all(writer->fd, data, size, writer->offset - size);
+    }
+#endif // _WIN32
+}
+
+// Wait for the last write that was started
+// Returns true on success, false if it or an earlier write failed
+static bool nob__file_writer_wait(Nob_File_Writer *writer)
+{
+    if (!writer->pending) return !writer->failed;
+    writer->pending = false;
+#ifdef _WIN32
+    DWORD written = 0;
+    if (!GetOverlappedResult(writer->fd, &writer->overlapped, &written, TRUE) || written != writer->pending_size) {
+        nob_log(NOB_ERROR, "Could not write into file %s: %s", writer->temp_path, nob_win32_error_message(GetLastError()));
+        writer->failed = true;
+    }
+#else
+    if (writer->background) nob__sema_wait(&writer->written);
+    if (writer->job_error != 0) {
+        nob_log(NOB_ERROR, "Could not write into file %s: %s", writer->temp_path, strerror(writer->job_error));
+        writer->failed = true;
+    }
+#endif // _WIN32
+    return !writer->failed;
+}
+
+// Start writing the chunk that was filled, once the chunk before it is written, and continue with the other one
+static void nob__file_writer_submit(Nob_File_Writer *writer)
+{
+    if (!nob__file_writer_wait(writer)) return;
+    Nob_String_Builder *chunk = &writer->chunks[writer->current];
+    if (chunk->count == 0) return;
+    writer->current = 1 - writer->current;
+    writer->chunks[writer->current].count = 0;
+    nob__file_writer_start(writer, chunk->items, chunk->count);
+}
+
+// Wait for the writes and close the temporary file, flushing it to disk if flush is set
+// Returns true on success, false on failure
+static bool nob__file_writer_finish(Nob_File_Writer *writer, bool flush)
+{
+    bool result = nob__file_writer_wait(writer);
+#ifdef _WIN32
+    if (result && flush && !FlushFileBuffers(writer->fd)) {
+        nob_log(NOB_ERROR, "Could not flush file %s: %s", writer->temp_path, nob_win32_error_message(GetLastError()));
+        result = false;
+    }
+    CloseHandle(writer->overlapped.hEvent);
+    CloseHandle(writer->fd);
+#else
+    if (writer->background) {
+        writer->stopping = true;
+        nob__sema_post(&writer->submitted);
+        pthread_join(writer->thread, NULL);
+        nob__sema_destroy(&writer->submitted);
+        nob__sema_destroy(&writer->written);
+    }
+    if (result && flush && fsync(writer->fd) < 0) {
+        nob_log(NOB_ERROR, "Could not flush file %s: %s", writer->temp_path, strerror(errno));
+        result = false;
+    }
+    close(writer->fd);
+#endif // _WIN32
+    return result;
+}
+
+static void nob__file_writer_free(Nob_File_Writer *writer, bool keep_temp)
+{
+    if (!keep_temp) remove(writer->temp_path);
+    nob_sb_free(writer->chunks[0]);
+    nob_sb_free(writer->chunks[1]);
+    NOB_FREE(writer->path);
+    NOB_FREE(writer);
+}
+
+Nob_File_Writer *nob_file_writer_open(const char *path)
+{
+    return nob__file_writer_open(path, true);
+}
+
+bool nob_file_writer_write(Nob_File_Writer *writer, const void *data, size_t size)
+{
+    const char *bytes = data;
+    // Every chunk is filled up to the chunk size, so a big write doesn't need a big chunk
+    while (size > 0 && !writer->failed) {
+        Nob_String_Builder *chunk = &writer->chunks[writer->current];
+        size_t n = NOB_FILE_WRITER_CHUNK_SIZE - chunk->count;
+        if (n > size) n = size;
+        nob_sb_append_buf(chunk, bytes, n);
+        bytes += n;
+        size -= n;
+        if (chunk->count >= NOB_FILE_WRITER_CHUNK_SIZE) nob__file_writer_submit(writer);
+    }
+    return !writer->failed;
+}
+
+// Put the temporary file in place, only logging errors, as the caller reports the file that it wrote
+static bool nob__file_writer_rename(Nob_File_Writer *writer)
+{
+#ifdef _WIN32
+    if (!MoveFileEx(writer->temp_path, writer->path, MOVEFILE_REPLACE_EXISTING)) {
+        nob_log(NOB_ERROR, "could not rename %s to %s: %s", writer->temp_path, writer->path, nob_win32_error_message(GetLastError()));
+        return false;
+    }
+#else
+    if (rename(writer->temp_path, writer->path) < 0) {
+        nob_log(NOB_ERROR, "could not rename %s to %s: %s", writer->temp_path, writer->path, strerror(errno));
+        return false;
+    }
+#endif // _WIN32
+    return true;
+}
+
+bool nob_file_writer_close(Nob_File_Writer *writer)
+{
+    nob__file_writer_submit(writer);
+    bool result = nob__file_writer_finish(writer, true);
+    result = result && nob__file_writer_rename(writer);
+    nob__file_writer_free(writer, result);
+    return result;
+}
+
+void nob_file_writer_abort(Nob_File_Writer *writer)
+{
+    nob__file_writer_finish(writer, false);
+    nob__file_writer_free(writer, false);
+}
+
+bool nob_write_entire_file_atomic(const char *path, const void *data, size_t size)
+{
+    Nob_File_Writer *writer = nob__file_writer_open(path, false);
+    if (writer == NULL) return false;
+    // The data is already there, so it is written as it is instead of being copied into chunks
+    const char *bytes = data;
+    while (size > 0 && !writer->failed) {
+        size_t n = size < (1u << 30) ? size : (1u << 30);
+        nob__file_writer_start(writer, bytes, n);
+        nob__file_writer_wait(writer);
+        bytes += n;
+        size -= n;
+    }
+    return nob_file_writer_close(writer);
+}
+
 const char *nob_temp_sv_to_cstr(Nob_String_View sv)
 {
     char *result = nob_temp_alloc(sv.count + 1);
-    NOB_ASSERT(result != NULL && "Extend the size of the temporary allocator");
+    NOB_ASSERT(result != NULL && "Buy more RAM lol");
     memcpy(result, sv.data, sv.count);
     result[sv.count] = '\0';
     return result;
@@ -1427,6 +2457,87 @@ defer:
     return result;
 }
 
+bool nob_map_file(const char *path, Nob_String_View *view, Nob_Map_Access access)
+{
+#ifdef _WIN32
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (access == NOB_MAP_SEQUENTIAL) flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    if (access == NOB_MAP_RANDOM) flags |= FILE_FLAG_RANDOM_ACCESS;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, flags, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, nob_win32_error_message(GetLastError()));
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        nob_log(NOB_ERROR, "Could not get the size of file %s: %s", path, nob_win32_error_message(GetLastError()));
+        CloseHandle(file);
+        return false;
+    }
+    // Empty files can't be mapped
+    if (file_size.QuadPart == 0) {
+        CloseHandle(file);
+        *view = nob_sv_from_parts("", 0);
+        return true;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    // The mapping keeps the file open, and the view keeps the mapping alive
+    CloseHandle(file);
+    if (mapping == NULL) {
+        nob_log(NOB_ERROR, "Could not map file %s: %s", path, nob_win32_error_message(GetLastError()));
+        return false;
+    }
+    const char *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (data == NULL) {
+        nob_log(NOB_ERROR, "Could not map file %s: %s", path, nob_win32_error_message(GetLastError()));
+        return false;
+    }
+    *view = nob_sv_from_parts(data, (size_t) file_size.QuadPart);
+    return true;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat statbuf;
+    if (fstat(fd, &statbuf) < 0) {
+        nob_log(NOB_ERROR, "Could not get the size of file %s: %s", path, strerror(errno));
+        close(fd);
+        return false;
+    }
+    // Empty files can't be mapped
+    if (statbuf.st_size == 0) {
+        close(fd);
+        *view = nob_sv_from_parts("", 0);
+        return true;
+    }
+    void *data = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file alive
+    close(fd);
+    if (data == MAP_FAILED) {
+        nob_log(NOB_ERROR, "Could not map file %s: %s", path, strerror(errno));
+        return false;
+    }
+    // The hint only changes how far the system reads ahead, so it doesn't matter if it isn't taken
+    if (access == NOB_MAP_SEQUENTIAL) posix_madvise(data, statbuf.st_size, POSIX_MADV_SEQUENTIAL);
+    if (access == NOB_MAP_RANDOM) posix_madvise(data, statbuf.st_size, POSIX_MADV_RANDOM);
+    *view = nob_sv_from_parts(data, (size_t) statbuf.st_size);
+    return true;
+#endif // _WIN32
+}
+
+void nob_unmap_file(Nob_String_View view)
+{
+    if (view.count == 0) return;
+#ifdef _WIN32
+    UnmapViewOfFile(view.data);
+#else
+    munmap((void *) view.data, view.count);
+#endif // _WIN32
+}
+
 Nob_String_View nob_sv_chop_by_delim(Nob_String_View *sv, char delim)
 {
     size_t i = 0;
@@ -1693,6 +2804,12 @@ int closedir(DIR *dirp)
         #define copy_directory_recursively nob_copy_directory_recursively
         #define read_entire_dir nob_read_entire_dir
         #define write_entire_file nob_write_entire_file
+        #define File_Writer Nob_File_Writer
+        #define file_writer_open nob_file_writer_open
+        #define file_writer_write nob_file_writer_write
+        #define file_writer_close nob_file_writer_close
+        #define file_writer_abort nob_file_writer_abort
+        #define write_entire_file_atomic nob_write_entire_file_atomic
         #define get_file_type nob_get_file_type
         #define return_defer nob_return_defer
         #define da_append nob_da_append
@@ -1700,6 +2817,12 @@ int closedir(DIR *dirp)
         #define da_append_many nob_da_append_many
         #define String_Builder Nob_String_Builder
         #define read_entire_file nob_read_entire_file
+        #define MAP_DEFAULT NOB_MAP_DEFAULT
+        #define MAP_SEQUENTIAL NOB_MAP_SEQUENTIAL
+        #define MAP_RANDOM NOB_MAP_RANDOM
+        #define Map_Access Nob_Map_Access
+        #define map_file nob_map_file
+        #define unmap_file nob_unmap_file
         #define sb_append_buf nob_sb_append_buf
         #define sb_append_cstr nob_sb_append_cstr
         #define sb_append_null nob_sb_append_null
@@ -1735,6 +2858,24 @@ int closedir(DIR *dirp)
         #define temp_reset nob_temp_reset
         #define temp_save nob_temp_save
         #define temp_rewind nob_temp_rewind
+        #define temp_peak nob_temp_peak
+        #define temp_free nob_temp_free
+        #define temp_scope nob_temp_scope
+        #define Thread_Pool Nob_Thread_Pool
+        #define Task_Group Nob_Task_Group
+        #define Task_Func Nob_Task_Func
+        #define Parallel_For_Func Nob_Parallel_For_Func
+        #define processor_count nob_processor_count
+        #define thread_pool_create nob_thread_pool_create
+        #define thread_pool_thread_count nob_thread_pool_thread_count
+        #define thread_pool_worker nob_thread_pool_worker
+        #define thread_pool_destroy nob_thread_pool_destroy
+        #define task_group_create nob_task_group_create
+        #define thread_pool_submit nob_thread_pool_submit
+        #define task_group_wait nob_task_group_wait
+        #define parallel_for nob_parallel_for
+        #define log_async_start nob_log_async_start
+        #define log_async_stop nob_log_async_stop
         #define path_name nob_path_name
         #define rename nob_rename
         #define needs_rebuild nob_needs_rebuild
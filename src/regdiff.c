@@ -0,0 +1,224 @@
+#define NOB_IMPLEMENTATION
+#define NOB_STRIP_PREFIX
+#include "nob.h"
+// Undefine the log error types, because it conflicts with windows.h
+#undef ERROR
+#undef INFO
+#undef WARNING
+
+#include <stdio.h>
+#include <string.h>
+
+#define REGISTRY_IMPLEMENTATION
+#include "registry.h"
+
+// Name of the input that stands for the registry of this machine
+#define LIVE_INPUT "live"
+
+void log_usage(Nob_Log_Level level, const char* program) {
+    nob_log(level, "Usage: %s <old> <new> [options]", program);
+    nob_log(level, "Writes a .reg patch that turns the keys of <old> into the keys of <new>.");
+    nob_log(level, "Both are .reg files or snapshots, or `"LIVE_INPUT"` for the registry of this machine (Windows only).");
+}
+
+void log_options(Nob_Log_Level level) {
+    nob_log(level, "Available options:");
+    nob_log(level, "  -o <file>          Write the patch to a file instead of stdout");
+    nob_log(level, "  --help             Shows this help message");
+}
+
+// Read the keys of other from the registry of this machine into live
+// Keys that don't exist on this machine are left out
+// Returns true on success, false on failure
+bool read_live(const Registry_File* other, Registry_File* live) {
+#ifdef _WIN32
+    memset(live, 0, sizeof(*live));
+    for (size_t i = 0; i < other->keys.count; ++i) {
+        const Registry_Key* key = &other->keys.items[i];
+        if (key->deleted) continue;
+
+        HKEY handle;
+        long code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, key->path, 0, KEY_READ, &handle);
+        if (code == ERROR_FILE_NOT_FOUND) continue;
+        if (code != ERROR_SUCCESS) {
+            nob_log(NOB_ERROR, "Couldn't open registry key %s: %ld", key->path, code);
+            return false;
+        }
+        // The path belongs to other, and the names and data are never freed, as the program exits right after
+        Registry_Key live_key = {.path = key->path};
+        bool result = reg_key_list_values(handle, &live_key.list);
+        RegCloseKey(handle);
+        if (!result) return false;
+        // The keys of other are sorted, so the live keys are too
+        da_append(&live->keys, live_key);
+    }
+    return true;
+#else
+    UNUSED(other);
+    UNUSED(live);
+    nob_log(NOB_ERROR, "Reading the live registry is only possible on Windows");
+    return false;
+#endif // _WIN32
+}
+
+// Totals of all keys of the diff
+typedef struct {
+    size_t keys;
+    size_t added;
+    size_t removed;
+    size_t changed;
+} Diff_Totals;
+
+// Add the diff of a single key to the patch
+void diff_key(const char* path, const Registry_Value_List original, const Registry_Value_List target, bool delete_key, String_Builder* patch, Diff_Totals* totals) {
+    Registry_Key_Diff diff = {0};
+    reg_key_diff_states(original, target, &diff);
+    diff.delete_key = delete_key;
+    if (diff.delete_key || diff.patch.count > 0) {
+        reg_key_diff_add_to_file(path, &diff, patch);
+        totals->keys += 1;
+        totals->added += diff.added;
+        totals->removed += diff.removed;
+        totals->changed += diff.changed;
+    }
+    reg_key_diff_free(&diff);
+}
+
+// Check whether a file keeps a subkey of path, looking at the sorted keys from index start on
+// Deleted subkeys don't count.
+bool has_subkeys(const Registry_File* file, size_t start, const char* path) {
+    size_t checkpoint = temp_save();
+    const char* prefix = temp_sprintf("%s\\", path);
+    size_t prefix_len = strlen(prefix);
+    bool result = false;
+    for (size_t i = start; i < file->keys.count; ++i) {
+        const Registry_Key* key = &file->keys.items[i];
+        size_t len = strlen(key->path);
+        int order = reg_name_compare(key->path, len < prefix_len ? len : prefix_len, prefix, prefix_len);
+        // Keys like `path x` sort between path and its subkeys
+        if (order < 0 || (order == 0 && len == prefix_len)) continue;
+        if (order > 0) break;
+        if (!key->deleted) {
+            result = true;
+            break;
+        }
+    }
+    temp_rewind(checkpoint);
+    return result;
+}
+
+// Add the removal of a key that isn't in the new file to the patch
+// Importing [-key] deletes the subkeys as well, and the subkeys that the new file keeps only get the values that
+// changed. So while there are any, the values of the key are deleted instead of the key itself.
+void diff_removed_key(const Registry_Key* old_key, const Registry_File* new_file, size_t j, String_Builder* patch, Diff_Totals* totals) {
+    const Registry_Value_List empty = {0};
+    bool delete_key = !has_subkeys(new_file, j, old_key->path);
+    diff_key(old_key->path, old_key->list, empty, delete_key, patch, totals);
+}
+
+// Add the changes that turn the keys of old_file into the keys of new_file to the patch
+// Walks through the sorted keys of both files at the same time
+void diff_files(const Registry_File* old_file, const Registry_File* new_file, String_Builder* patch, Diff_Totals* totals) {
+    const Registry_Value_List empty = {0};
+    size_t i = 0;
+    size_t j = 0;
+    while (i < old_file->keys.count || j < new_file->keys.count) {
+        const Registry_Key* old_key = i < old_file->keys.count ? &old_file->keys.items[i] : NULL;
+        const Registry_Key* new_key = j < new_file->keys.count ? &new_file->keys.items[j] : NULL;
+        int order = old_key == NULL ? 1
+                  : new_key == NULL ? -1
+                  : reg_name_compare(old_key->path, strlen(old_key->path), new_key->path, strlen(new_key->path));
+
+        if (order < 0) {
+            // The key only exists in the old file
+            if (!old_key->deleted) diff_removed_key(old_key, new_file, j, patch, totals);
+            ++i;
+        } else if (order > 0) {
+            // The key only exists in the new file
+            if (!new_key->deleted) diff_key(new_key->path, empty, new_key->list, false, patch, totals);
+            ++j;
+        } else {
+            if (new_key->deleted) {
+                if (!old_key->deleted) diff_removed_key(old_key, new_file, j + 1, patch, totals);
+            } else {
+                diff_key(new_key->path, old_key->deleted ? empty : old_key->list, new_key->list, false, patch, totals);
+            }
+            ++i;
+            ++j;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    int result = 0;
+    Registry_File old_file = {0};
+    Registry_File new_file = {0};
+    String_Builder patch = {0};
+    Diff_Totals totals = {0};
+
+    const char* program = shift(argv, argc);
+    const char* inputs[2] = {0};
+    size_t input_count = 0;
+    const char* output_path = NULL;
+
+    // Parse the options
+    while (argc > 0) {
+        const char* option = shift(argv, argc);
+        if (strcmp(option, "-o") == 0) {
+            if (argc < 1) {
+                log_usage(NOB_ERROR, program);
+                nob_log(NOB_ERROR, "Missing output file");
+                return_defer(1);
+            }
+            output_path = shift(argv, argc);
+        } else if (strcmp(option, "--help") == 0) {
+            log_usage(NOB_INFO, program);
+            log_options(NOB_INFO);
+            return_defer(0);
+        } else if (option[0] == '-' && option[1] != '\0') {
+            log_usage(NOB_ERROR, program);
+            log_options(NOB_ERROR);
+            nob_log(NOB_ERROR, "Invalid option %s", option);
+            return_defer(1);
+        } else if (input_count < ARRAY_LEN(inputs)) {
+            inputs[input_count++] = option;
+        } else {
+            log_usage(NOB_ERROR, program);
+            nob_log(NOB_ERROR, "Too many inputs");
+            return_defer(1);
+        }
+    }
+    if (input_count != ARRAY_LEN(inputs)) {
+        log_usage(NOB_ERROR, program);
+        nob_log(NOB_ERROR, "Expected two inputs");
+        return_defer(1);
+    }
+    const bool old_live = strcmp(inputs[0], LIVE_INPUT) == 0;
+    const bool new_live = strcmp(inputs[1], LIVE_INPUT) == 0;
+    if (old_live && new_live) {
+        nob_log(NOB_ERROR, "Only one of the inputs can be the live registry");
+        return_defer(1);
+    }
+
+    // The live registry is read after the file, as only the keys of the file are read from it
+    if (!old_live && !reg_file_read(inputs[0], &old_file)) return_defer(1);
+    if (!new_live && !reg_file_read(inputs[1], &new_file)) return_defer(1);
+    if (old_live && !read_live(&new_file, &old_file)) return_defer(1);
+    if (new_live && !read_live(&old_file, &new_file)) return_defer(1);
+
+    sb_append_cstr(&patch, "Windows Registry Editor Version 5.00\n");
+    diff_files(&old_file, &new_file, &patch, &totals);
+
+    if (output_path != NULL) {
+        if (!write_entire_file(output_path, patch.items, patch.count)) return_defer(1);
+    } else {
+        fwrite(patch.items, 1, patch.count, stdout);
+    }
+    nob_log(NOB_INFO, "%zu keys differ: %zu values added, %zu removed, %zu changed", totals.keys, totals.added, totals.removed, totals.changed);
+
+defer:
+    reg_file_free(&old_file);
+    reg_file_free(&new_file);
+    sb_free(patch);
+    return result;
+}
@@ -0,0 +1,794 @@
+#define NOB_IMPLEMENTATION
+#define NOB_STRIP_PREFIX
+#include "nob.h"
+// Undefine the log error types, because it conflicts with windows.h
+#undef ERROR
+#undef INFO
+#undef WARNING
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+#define REGISTRY_IMPLEMENTATION
+#include "registry.h"
+#define FONTS_IMPLEMENTATION
+#include "fonts.h"
+
+#define BACKUP_FONTS_REG_FILENAME "backup_fonts.reg"
+#define BACKUP_FONTS_SNAPSHOT_FILENAME "backup_fonts.snapshot"
+// Directory that the output of every machine is written to by default
+#define DEFAULT_OUTPUT_DIR "fleet"
+// The font keys are all in the SOFTWARE hive
+#define SOFTWARE_HIVE_PREFIX "SOFTWARE\\"
+
+void log_usage(Nob_Log_Level level, const char* program) {
+    nob_log(level, "Usage: %s batch <dir> <font> [options]", program);
+    nob_log(level, "       %s inventory <dir> [options]", program);
+    nob_log(level, "batch makes the change of changefont for every machine export in a directory, replacing all fonts with <font>.");
+    nob_log(level, "inventory counts the machines of every font, conflicting font substitute and variant of a font link as CSV.");
+    nob_log(level, "The exports are .reg files, snapshots (both possibly compressed) or SOFTWARE hive files. The machine is named after the file.");
+    nob_log(level, "<font> is the name of a value of the Fonts key, with or without the bracketed part, like `Arial` or `Arial (TrueType)`.");
+}
+
+void log_options(Nob_Log_Level level) {
+    nob_log(level, "Available options:");
+    nob_log(level, "  -o <path>          batch: directory to write a directory with the files of every machine to (default: "DEFAULT_OUTPUT_DIR")");
+    nob_log(level, "                     inventory: file to write the CSV to instead of stdout");
+    nob_log(level, "  -j <threads>       Amount of worker threads (default: one per processor)");
+    nob_log(level, "  --help             Shows this help message");
+}
+
+// A machine export in the input directory
+typedef struct {
+    char* path;
+    // The name of the file without its extensions
+    char* name;
+} Machine;
+
+typedef struct {
+    Machine* items;
+    size_t count;
+    size_t capacity;
+} Machines;
+
+// The font keys of a machine, along with whatever owns their values
+typedef struct {
+    Font_Keys keys;
+    // Owns the values of a .reg file or snapshot
+    Registry_File file;
+    // The values were read from a hive, so the keys own them
+    bool from_hive;
+} Machine_Keys;
+
+// Kinds of facts that the inventory counts the machines of
+typedef enum {
+    // name is a font name
+    INVENTORY_FONT,
+    // name is a font substitute, value is the font it is substituted with
+    INVENTORY_SUBSTITUTE,
+    // name is a font, value is the data of its font link
+    INVENTORY_LINK,
+    INVENTORY_KIND_COUNT,
+} Inventory_Kind;
+
+const char* inventory_kind_names[INVENTORY_KIND_COUNT] = {"font", "substitute", "link"};
+
+// A fact along with the amount of machines that have it
+typedef struct {
+    Inventory_Kind kind;
+    // IDs of the name and value in the strings of the inventory, which identify the fact
+    uint32_t name;
+    uint32_t value;
+    bool used;
+    size_t machines;
+    // Index plus one of the last machine that was counted, so a machine with a fact twice is counted once
+    size_t last_machine;
+} Inventory_Entry;
+
+// No spelling was recorded for a string
+#define INVENTORY_NO_SPELLING UINT32_MAX
+
+// The spelling of a name on the first machine that has it
+typedef struct {
+    uint32_t id;
+    size_t machine;
+} Inventory_Spelling;
+
+typedef struct {
+    Inventory_Spelling* items;
+    size_t count;
+    size_t capacity;
+} Inventory_Spellings;
+
+// Hash table of facts with linear probing, on the IDs of their strings
+// Names are case insensitive like in the registry, so they are interned in lowercase, and the spelling of every name
+// on the first machine that has it is kept for the report, however the machines were spread over the workers.
+// The data of font links is interned as it is, so it is compared byte for byte.
+typedef struct {
+    Inventory_Entry* entries;
+    // Always a power of two, or 0
+    size_t capacity;
+    size_t count;
+    Registry_Strings strings;
+    // Spelling of every lowercase name, by the ID of the name
+    Inventory_Spellings spellings;
+    // Scratch buffer for lowercasing names
+    String_Builder folded;
+} Inventory;
+
+// Work that is shared between all worker threads
+typedef struct {
+    const Machines* machines;
+    // Count the facts of every machine, instead of writing its files
+    bool inventory;
+    const char* font;
+    const char* output_dir;
+    // The buffers of every thread of the pool, indexed by nob_thread_pool_worker
+    struct Worker* workers;
+    atomic_size_t failed;
+    atomic_size_t without_font;
+} Batch;
+
+// A worker thread, with buffers that are reused for every machine it processes
+typedef struct Worker {
+    Batch* batch;
+    String_Builder reg;
+    String_Builder snapshot;
+    String_Builder path;
+    // The facts of the machines of this worker, which are merged once all workers are done
+    Inventory inventory;
+} Worker;
+
+// Get the monotonic time in seconds
+double now_seconds() {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart / frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// Remove an extension from the end of a name, if it has it
+void strip_extension(char* name, const char* extension) {
+    size_t name_len = strlen(name);
+    size_t extension_len = strlen(extension);
+    if (name_len > extension_len && reg_name_compare(name + name_len - extension_len, extension_len, extension, extension_len) == 0) {
+        name[name_len - extension_len] = '\0';
+    }
+}
+
+int compare_file_names(const void* a, const void* b) {
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+int compare_machine_names(const void* a, const void* b) {
+    const Machine* machine_a = *(const Machine* const*) a;
+    const Machine* machine_b = *(const Machine* const*) b;
+    return reg_name_compare(machine_a->name, strlen(machine_a->name), machine_b->name, strlen(machine_b->name));
+}
+
+// Check that no two machines have the same name, case insensitive, like the output directories they get
+// Returns true on success, false on failure
+bool machines_check_names(const Machines* machines) {
+    if (machines->count < 2) return true;
+    const Machine** sorted = malloc(sizeof(*sorted) * machines->count);
+    assert(sorted != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < machines->count; ++i) sorted[i] = &machines->items[i];
+    qsort(sorted, machines->count, sizeof(*sorted), compare_machine_names);
+
+    bool result = true;
+    for (size_t i = 1; i < machines->count; ++i) {
+        if (compare_machine_names(&sorted[i - 1], &sorted[i]) == 0) {
+            nob_log(NOB_ERROR, "Files %s and %s are both exports of machine %s", sorted[i - 1]->path, sorted[i]->path, sorted[i]->name);
+            result = false;
+        }
+    }
+    free(sorted);
+    return result;
+}
+
+// Add every file in a directory to the machines, sorted by name
+// The name of a machine is the name of its file without the extensions, which has to be unique.
+// Returns true on success, false on failure
+bool machines_read_dir(const char* dir, Machines* machines) {
+    File_Paths children = {0};
+    if (!read_entire_dir(dir, &children)) return false;
+    qsort(children.items, children.count, sizeof(*children.items), compare_file_names);
+    for (size_t i = 0; i < children.count; ++i) {
+        if (children.items[i][0] == '.') continue;
+        const char* path = temp_sprintf("%s/%s", dir, children.items[i]);
+        if (get_file_type(path) != FILE_REGULAR) continue;
+
+        Machine machine = {.path = strdup(path), .name = strdup(children.items[i])};
+        assert(machine.path != NULL && machine.name != NULL && "Buy more RAM lol");
+        strip_extension(machine.name, ".lz");
+        strip_extension(machine.name, ".reg");
+        strip_extension(machine.name, ".snapshot");
+        strip_extension(machine.name, ".hiv");
+        da_append(machines, machine);
+    }
+    da_free(children);
+    temp_reset();
+    return machines_check_names(machines);
+}
+
+void machines_free(Machines* machines) {
+    for (size_t i = 0; i < machines->count; ++i) {
+        free(machines->items[i].path);
+        free(machines->items[i].name);
+    }
+    da_free(*machines);
+}
+
+// Check whether a file starts like a registry hive
+bool is_hive_file(const char* path) {
+    char magic[4] = {0};
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return false;
+    size_t read = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return read == sizeof(magic) && memcmp(magic, REG_HIVE_MAGIC, sizeof(magic)) == 0;
+}
+
+// Read the values of a font key from a hive
+// A key that the hive doesn't have is left empty
+// Returns true on success, false on failure
+bool hive_read_key(const Registry_Hive* hive, Registry_Key* key) {
+    uint32_t offset = 0;
+    if (!reg_hive_find_key(hive, key->path + strlen(SOFTWARE_HIVE_PREFIX), &offset)) return true;
+    return reg_hive_key_list_values(hive, offset, &key->list);
+}
+
+// Read the font keys of a machine from a .reg file, snapshot or hive
+// Keys that the export doesn't have are left empty
+// Returns true on success, false on failure
+bool machine_keys_read(const char* path, Machine_Keys* machine) {
+    memset(machine, 0, sizeof(*machine));
+    machine->keys.fonts.path = FONTS_REGISTRY_PATH;
+    machine->keys.font_substitutes.path = FONT_SUBSTITUTES_REGISTRY_PATH;
+    machine->keys.font_links.path = FONT_LINK_REGISTRY_PATH;
+
+    if (is_hive_file(path)) {
+        machine->from_hive = true;
+        Registry_Hive hive = {0};
+        if (!reg_hive_open(path, &hive)) return false;
+        bool result = hive_read_key(&hive, &machine->keys.fonts)
+                   && hive_read_key(&hive, &machine->keys.font_substitutes)
+                   && hive_read_key(&hive, &machine->keys.font_links);
+        reg_hive_close(&hive);
+        return result;
+    }
+
+    if (!reg_file_read(path, &machine->file)) return false;
+    Registry_Key* keys[] = {&machine->keys.fonts, &machine->keys.font_substitutes, &machine->keys.font_links};
+    for (size_t i = 0; i < ARRAY_LEN(keys); ++i) {
+        const Registry_Key* key = reg_file_find_key(&machine->file, keys[i]->path);
+        if (key != NULL && !key->deleted) *keys[i] = *key;
+    }
+    return true;
+}
+
+void machine_keys_free(Machine_Keys* machine) {
+    if (machine->from_hive) {
+        reg_value_list_free(&machine->keys.fonts.list);
+        reg_value_list_free(&machine->keys.font_substitutes.list);
+        reg_value_list_free(&machine->keys.font_links.list);
+    }
+    reg_file_free(&machine->file);
+    memset(machine, 0, sizeof(*machine));
+}
+
+// Find the font with a name, either the name of its value or the font name that is derived from it
+// Returns the index of the font, or -1 if there is none
+long find_font(const Registry_Value_List font_list, const Registry_Value_List substitute_list, const char* font) {
+    size_t font_len = strlen(font);
+    for (size_t i = 0; i < font_list.count; ++i) {
+        const Registry_Value* derived = &substitute_list.items[i];
+        if (reg_name_compare(derived->name, derived->name_len, font, font_len) == 0) return (long) i;
+        if (reg_name_compare(font_list.items[i].name, strlen(font_list.items[i].name), font, font_len) == 0) return (long) i;
+    }
+    return -1;
+}
+
+// Build the path of an output file of a machine in the path buffer of a worker
+const char* worker_path(Worker* worker, const char* machine, const char* file) {
+    worker->path.count = 0;
+    sb_append_cstr(&worker->path, worker->batch->output_dir);
+    sb_append_cstr(&worker->path, "/");
+    sb_append_cstr(&worker->path, machine);
+    if (file != NULL) {
+        sb_append_cstr(&worker->path, "/");
+        sb_append_cstr(&worker->path, file);
+    }
+    sb_append_null(&worker->path);
+    return worker->path.items;
+}
+
+// Write the backup, the change and the restore file of a machine to its output directory
+// Returns true on success, false on failure
+bool process_machine(Worker* worker, const Machine* machine) {
+    bool result = true;
+    Machine_Keys machine_keys = {0};
+    Registry_Value_List substitute_list = {0};
+    Font_Change change = {0};
+    const Font_Keys* keys = &machine_keys.keys;
+
+    if (!machine_keys_read(machine->path, &machine_keys)) return_defer(false);
+    font_substitute_list_build(keys, &substitute_list);
+    long font_index = find_font(keys->fonts.list, substitute_list, worker->batch->font);
+    if (font_index < 0) {
+        nob_log(NOB_WARNING, "Machine %s doesn't have font %s, skipping it", machine->name, worker->batch->font);
+        atomic_fetch_add(&worker->batch->without_font, 1);
+        return_defer(true);
+    }
+
+    const char* dir = worker_path(worker, machine->name, NULL);
+    if (!file_exists(dir) && !mkdir_if_not_exists(dir)) return_defer(false);
+
+    // The same files as changefont writes next to itself
+    if (!font_backup_get_file(keys, substitute_list, &worker->reg)) return_defer(false);
+    if (!write_entire_file(worker_path(worker, machine->name, BACKUP_FONTS_REG_FILENAME), worker->reg.items, worker->reg.count)) return_defer(false);
+    Registry_Key snapshot_keys[] = {keys->fonts, keys->font_substitutes, keys->font_links};
+    worker->snapshot.count = 0;
+    reg_snapshot_serialize(snapshot_keys, ARRAY_LEN(snapshot_keys), &worker->snapshot);
+    if (!write_entire_file(worker_path(worker, machine->name, BACKUP_FONTS_SNAPSHOT_FILENAME), worker->snapshot.items, worker->snapshot.count)) return_defer(false);
+
+    font_change_compute(keys, substitute_list, (size_t) font_index, &change);
+    const char* font_name = keys->fonts.list.items[font_index].name;
+    char file_name[REG_MAX_VALUE_NAME + 32];
+    if (!font_change_get_restore_file(&change, &worker->reg)) return_defer(false);
+    snprintf(file_name, sizeof(file_name), "restore_fonts_%s.reg", font_name);
+    if (!write_entire_file(worker_path(worker, machine->name, file_name), worker->reg.items, worker->reg.count)) return_defer(false);
+    font_change_get_patch_file(&change, &worker->reg);
+    snprintf(file_name, sizeof(file_name), "fonts_%s.reg", font_name);
+    if (!write_entire_file(worker_path(worker, machine->name, file_name), worker->reg.items, worker->reg.count)) return_defer(false);
+
+defer:
+    if (!result) atomic_fetch_add(&worker->batch->failed, 1);
+    font_change_free(&change);
+    font_substitute_list_free(&substitute_list);
+    machine_keys_free(&machine_keys);
+    return result;
+}
+
+// Lowercase an ASCII character, like the registry does when it compares names
+static inline int fold(char chr) {
+    unsigned char byte = (unsigned char) chr;
+    return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+}
+
+// Hash of a fact, from the IDs of its strings
+uint64_t inventory_hash(Inventory_Kind kind, uint32_t name, uint32_t value) {
+    // Finalizer of SplitMix64, so the IDs that are handed out in order spread over the whole table
+    uint64_t hash = (((uint64_t) name << 32) | value) + (uint64_t) kind * 0x9e3779b97f4a7c15ULL;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+// Double the capacity of an inventory, and put every entry in its new place
+void inventory_grow(Inventory* inventory) {
+    size_t old_capacity = inventory->capacity;
+    Inventory_Entry* old_entries = inventory->entries;
+    inventory->capacity = old_capacity == 0 ? 1024 : old_capacity * 2;
+    inventory->entries = calloc(inventory->capacity, sizeof(*inventory->entries));
+    assert(inventory->entries != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < old_capacity; ++i) {
+        const Inventory_Entry* entry = &old_entries[i];
+        if (!entry->used) continue;
+        size_t slot = inventory_hash(entry->kind, entry->name, entry->value) & (inventory->capacity - 1);
+        while (inventory->entries[slot].used) slot = (slot + 1) & (inventory->capacity - 1);
+        inventory->entries[slot] = *entry;
+    }
+    free(old_entries);
+}
+
+// Find the entry of a fact, adding it if the inventory doesn't have it yet
+Inventory_Entry* inventory_find(Inventory* inventory, Inventory_Kind kind, uint32_t name, uint32_t value) {
+    // Stay at most half full, so probe sequences stay short
+    if ((inventory->count + 1) * 2 > inventory->capacity) inventory_grow(inventory);
+
+    size_t slot = inventory_hash(kind, name, value) & (inventory->capacity - 1);
+    while (inventory->entries[slot].used) {
+        Inventory_Entry* entry = &inventory->entries[slot];
+        if (entry->kind == kind && entry->name == name && entry->value == value) return entry;
+        slot = (slot + 1) & (inventory->capacity - 1);
+    }
+
+    Inventory_Entry* entry = &inventory->entries[slot];
+    *entry = (Inventory_Entry) {.kind = kind, .name = name, .value = value, .used = true};
+    inventory->count += 1;
+    return entry;
+}
+
+// Intern a string in an inventory, as it is
+// Returns the ID of the string
+uint32_t inventory_intern(Inventory* inventory, const char* string, size_t len) {
+    uint32_t id = reg_strings_intern(&inventory->strings, string, len);
+    while (inventory->spellings.count < inventory->strings.count) {
+        Inventory_Spelling spelling = {.id = INVENTORY_NO_SPELLING};
+        da_append(&inventory->spellings, spelling);
+    }
+    return id;
+}
+
+// Keep a spelling of a name, if it was seen on an earlier machine than the one that is kept
+void inventory_spell(Inventory* inventory, uint32_t name, const char* spelling, size_t len, size_t machine) {
+    const Inventory_Spelling* kept = &inventory->spellings.items[name];
+    if (kept->id != INVENTORY_NO_SPELLING && kept->machine <= machine) return;
+    uint32_t id = inventory_intern(inventory, spelling, len);
+    inventory->spellings.items[name] = (Inventory_Spelling) {.id = id, .machine = machine};
+}
+
+// Intern a name of a machine in an inventory in lowercase, and keep its spelling
+// Returns the ID of the lowercase name
+uint32_t inventory_intern_name(Inventory* inventory, size_t machine, const char* name, size_t len) {
+    inventory->folded.count = 0;
+    for (size_t i = 0; i < len; ++i) da_append(&inventory->folded, (char) fold(name[i]));
+    // Empty names still need a buffer to intern
+    da_append(&inventory->folded, '\0');
+    uint32_t id = inventory_intern(inventory, inventory->folded.items, len);
+    inventory_spell(inventory, id, name, len, machine);
+    return id;
+}
+
+// Count a machine for a fact, unless it was already counted for it
+// The value is a name as well, unless the fact is a font link
+void inventory_count(Inventory* inventory, size_t machine, Inventory_Kind kind, const char* name, size_t name_len, const char* value, size_t value_len) {
+    uint32_t name_id = inventory_intern_name(inventory, machine, name, name_len);
+    uint32_t value_id = kind == INVENTORY_LINK
+        ? inventory_intern(inventory, value, value_len)
+        : inventory_intern_name(inventory, machine, value, value_len);
+    Inventory_Entry* entry = inventory_find(inventory, kind, name_id, value_id);
+    if (entry->last_machine == machine + 1) return;
+    entry->last_machine = machine + 1;
+    entry->machines += 1;
+}
+
+// Get the ID of a string of another inventory in an inventory, interning it if needed
+// ids holds the IDs of the strings of other that were already looked up, so every string is only interned once
+// If the string is a name, its spelling is taken over if it is from an earlier machine
+uint32_t inventory_merge_string(Inventory* inventory, const Inventory* other, uint32_t* ids, uint32_t id, bool name) {
+    if (ids[id] == INVENTORY_NO_SPELLING) {
+        ids[id] = inventory_intern(inventory, other->strings.items[id].data, other->strings.items[id].len);
+    }
+    if (name) {
+        const Inventory_Spelling* spelling = &other->spellings.items[id];
+        const Registry_String* string = &other->strings.items[spelling->id];
+        inventory_spell(inventory, ids[id], string->data, string->len, spelling->machine);
+    }
+    return ids[id];
+}
+
+// Add the counts of another inventory, which counted other machines
+// The strings of the other inventory are looked up once, after that the facts are merged on their IDs
+void inventory_merge(Inventory* inventory, const Inventory* other) {
+    if (other->strings.count == 0) return;
+    uint32_t* ids = malloc(sizeof(*ids) * other->strings.count);
+    assert(ids != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < other->strings.count; ++i) ids[i] = INVENTORY_NO_SPELLING;
+    for (size_t i = 0; i < other->capacity; ++i) {
+        const Inventory_Entry* entry = &other->entries[i];
+        if (!entry->used) continue;
+        uint32_t name = inventory_merge_string(inventory, other, ids, entry->name, true);
+        uint32_t value = inventory_merge_string(inventory, other, ids, entry->value, entry->kind != INVENTORY_LINK);
+        inventory_find(inventory, entry->kind, name, value)->machines += entry->machines;
+    }
+    free(ids);
+}
+
+void inventory_free(Inventory* inventory) {
+    free(inventory->entries);
+    reg_strings_free(&inventory->strings);
+    da_free(inventory->spellings);
+    sb_free(inventory->folded);
+    memset(inventory, 0, sizeof(*inventory));
+}
+
+// Count the fonts, font substitutes and font links of a machine in the inventory of a worker
+// Returns true on success, false on failure
+bool inventory_machine(Worker* worker, size_t index) {
+    const Machine* machine = &worker->batch->machines->items[index];
+    Machine_Keys machine_keys = {0};
+    if (!machine_keys_read(machine->path, &machine_keys)) {
+        atomic_fetch_add(&worker->batch->failed, 1);
+        machine_keys_free(&machine_keys);
+        return false;
+    }
+
+    Inventory* inventory = &worker->inventory;
+    const Registry_Value_List fonts = machine_keys.keys.fonts.list;
+    for (size_t i = 0; i < fonts.count; ++i) {
+        size_t name_len = font_name_len(fonts.items[i].name, fonts.items[i].name_len);
+        inventory_count(inventory, index, INVENTORY_FONT, fonts.items[i].name, name_len, "", 0);
+    }
+    const Registry_Value_List substitutes = machine_keys.keys.font_substitutes.list;
+    for (size_t i = 0; i < substitutes.count; ++i) {
+        const Registry_Value* value = &substitutes.items[i];
+        if (value->type != REG_TYPE_STRING) continue;
+        const char* data = value->data != NULL ? value->data : "";
+        inventory_count(inventory, index, INVENTORY_SUBSTITUTE, value->name, value->name_len, data, reg_value_string_len(value));
+    }
+    const Registry_Value_List links = machine_keys.keys.font_links.list;
+    for (size_t i = 0; i < links.count; ++i) {
+        const Registry_Value* value = &links.items[i];
+        if (value->type != REG_TYPE_HEX) continue;
+        inventory_count(inventory, index, INVENTORY_LINK, value->name, value->name_len, value->data, value->data_len);
+    }
+
+    machine_keys_free(&machine_keys);
+    return true;
+}
+
+// A fact of the merged inventory, for sorting
+typedef struct {
+    Inventory_Kind kind;
+    // ID of the lowercase name, which is the same for all rows of a name
+    uint32_t name_id;
+    const char* name;
+    size_t name_len;
+    const char* value;
+    size_t value_len;
+    size_t machines;
+} Inventory_Row;
+
+typedef struct {
+    Inventory_Row* items;
+    size_t count;
+    size_t capacity;
+} Inventory_Rows;
+
+// Sort rows by kind and name, and the rows of a name by the amount of machines, most first
+int inventory_row_compare(const void* a, const void* b) {
+    const Inventory_Row* row_a = a;
+    const Inventory_Row* row_b = b;
+    if (row_a->kind != row_b->kind) return (int) row_a->kind - (int) row_b->kind;
+    int order = reg_name_compare(row_a->name, row_a->name_len, row_b->name, row_b->name_len);
+    if (order != 0) return order;
+    if (row_a->machines != row_b->machines) return row_a->machines > row_b->machines ? -1 : 1;
+    return reg_name_compare(row_a->value, row_a->value_len, row_b->value, row_b->value_len);
+}
+
+// Add a field to a CSV line, quoting it if needed
+void csv_append_field(String_Builder* sb, const char* field, size_t field_len) {
+    bool quote = false;
+    for (size_t i = 0; i < field_len && !quote; ++i) {
+        quote = field[i] == ',' || field[i] == '"' || field[i] == '\n' || field[i] == '\r';
+    }
+    if (!quote) {
+        sb_append_buf(sb, field, field_len);
+        return;
+    }
+    da_append(sb, '"');
+    for (size_t i = 0; i < field_len; ++i) {
+        if (field[i] == '"') da_append(sb, '"');
+        da_append(sb, field[i]);
+    }
+    da_append(sb, '"');
+}
+
+// Add a row to the CSV report
+// The data of font links is a REG_MULTI_SZ, which is written with its strings separated by semicolons.
+void csv_append_row(String_Builder* sb, const Inventory_Row* row, String_Builder* scratch) {
+    sb_append_cstr(sb, inventory_kind_names[row->kind]);
+    da_append(sb, ',');
+    csv_append_field(sb, row->name, row->name_len);
+    da_append(sb, ',');
+    if (row->kind == INVENTORY_LINK) {
+        scratch->count = 0;
+        reg_utf16le_to_utf8(row->value, row->value_len, scratch);
+        while (scratch->count > 0 && scratch->items[scratch->count - 1] == '\0') --scratch->count;
+        for (size_t i = 0; i < scratch->count; ++i) {
+            if (scratch->items[i] == '\0') scratch->items[i] = ';';
+        }
+        csv_append_field(sb, scratch->items, scratch->count);
+    } else {
+        csv_append_field(sb, row->value, row->value_len);
+    }
+    char machines[32];
+    snprintf(machines, sizeof(machines), ",%zu\n", row->machines);
+    sb_append_cstr(sb, machines);
+}
+
+// Write the merged inventory as CSV, with every font, every font substitute that isn't substituted with the same font
+// on every machine, and every variant of every font link
+void inventory_report(const Inventory* inventory, size_t machine_count, String_Builder* csv) {
+    Inventory_Rows rows = {0};
+    for (size_t i = 0; i < inventory->capacity; ++i) {
+        const Inventory_Entry* entry = &inventory->entries[i];
+        if (!entry->used) continue;
+        // Names are reported the way they are spelled on the first machine that has them
+        const Registry_String* name = &inventory->strings.items[inventory->spellings.items[entry->name].id];
+        const Registry_String* value = &inventory->strings.items[entry->kind == INVENTORY_LINK
+            ? entry->value : inventory->spellings.items[entry->value].id];
+        Inventory_Row row = {
+            .kind = entry->kind,
+            .name_id = entry->name,
+            .name = name->data,
+            .name_len = name->len,
+            .value = value->data,
+            .value_len = value->len,
+            .machines = entry->machines,
+        };
+        da_append(&rows, row);
+    }
+    qsort(rows.items, rows.count, sizeof(*rows.items), inventory_row_compare);
+
+    String_Builder scratch = {0};
+    size_t totals[INVENTORY_KIND_COUNT] = {0};
+    size_t variants[INVENTORY_KIND_COUNT] = {0};
+    sb_append_cstr(csv, "kind,name,value,machines\n");
+    for (size_t i = 0; i < rows.count;) {
+        // The rows of a single name are next to each other
+        size_t end = i + 1;
+        while (end < rows.count && rows.items[end].kind == rows.items[i].kind && rows.items[end].name_id == rows.items[i].name_id) {
+            ++end;
+        }
+        Inventory_Kind kind = rows.items[i].kind;
+        totals[kind] += 1;
+        if (end - i > 1) variants[kind] += 1;
+        // A substitute is only a conflict if it has more than one target
+        if (kind != INVENTORY_SUBSTITUTE || end - i > 1) {
+            for (size_t j = i; j < end; ++j) csv_append_row(csv, &rows.items[j], &scratch);
+        }
+        i = end;
+    }
+    nob_log(NOB_INFO, "%zu machines: %zu fonts, %zu of %zu font substitutes conflict, %zu of %zu font links have variants",
+        machine_count, totals[INVENTORY_FONT], variants[INVENTORY_SUBSTITUTE], totals[INVENTORY_SUBSTITUTE],
+        variants[INVENTORY_LINK], totals[INVENTORY_LINK]);
+    sb_free(scratch);
+    da_free(rows);
+}
+
+// Process a single machine on one of the threads of the pool
+// The machines are split over the threads of the pool, and idle threads steal the machines that others haven't started yet
+void fleet_machine(void* arg, size_t index, size_t worker_index) {
+    Batch* batch = arg;
+    Worker* worker = &batch->workers[worker_index];
+    if (batch->inventory) inventory_machine(worker, index);
+    else process_machine(worker, &batch->machines->items[index]);
+}
+
+int main(int argc, char** argv) {
+    int result = 0;
+    Machines machines = {0};
+    Worker* workers = NULL;
+    size_t worker_count = 0;
+    Thread_Pool* pool = NULL;
+    String_Builder csv = {0};
+
+    const char* program = shift(argv, argc);
+    if (argc < 1 || strcmp(argv[0], "--help") == 0) {
+        log_usage(argc < 1 ? NOB_ERROR : NOB_INFO, program);
+        log_options(argc < 1 ? NOB_ERROR : NOB_INFO);
+        return argc < 1;
+    }
+    const char* command = shift(argv, argc);
+    const bool inventory = strcmp(command, "inventory") == 0;
+    if (!inventory && strcmp(command, "batch") != 0) {
+        log_usage(NOB_ERROR, program);
+        nob_log(NOB_ERROR, "Invalid command %s", command);
+        return 1;
+    }
+
+    const char* inputs[2] = {0};
+    size_t input_count = 0;
+    const char* output_path = NULL;
+    size_t thread_count = 0;
+    // Parse the options
+    while (argc > 0) {
+        const char* option = shift(argv, argc);
+        if (strcmp(option, "-o") == 0 || strcmp(option, "-j") == 0) {
+            if (argc < 1) {
+                log_usage(NOB_ERROR, program);
+                nob_log(NOB_ERROR, "Missing %s value", option);
+                return_defer(1);
+            }
+            const char* value = shift(argv, argc);
+            if (option[1] == 'o') {
+                output_path = value;
+            } else {
+                char* end = NULL;
+                thread_count = strtoul(value, &end, 10);
+                if (end == value || *end != '\0' || thread_count == 0) {
+                    nob_log(NOB_ERROR, "Invalid amount of threads %s", value);
+                    return_defer(1);
+                }
+            }
+        } else if (strcmp(option, "--help") == 0) {
+            log_usage(NOB_INFO, program);
+            log_options(NOB_INFO);
+            return_defer(0);
+        } else if (option[0] == '-' && option[1] != '\0') {
+            log_usage(NOB_ERROR, program);
+            log_options(NOB_ERROR);
+            nob_log(NOB_ERROR, "Invalid option %s", option);
+            return_defer(1);
+        } else if (input_count < ARRAY_LEN(inputs)) {
+            inputs[input_count++] = option;
+        } else {
+            log_usage(NOB_ERROR, program);
+            nob_log(NOB_ERROR, "Too many inputs");
+            return_defer(1);
+        }
+    }
+    if (input_count != (inventory ? 1 : 2)) {
+        log_usage(NOB_ERROR, program);
+        nob_log(NOB_ERROR, inventory ? "Expected a directory" : "Expected a directory and a font");
+        return_defer(1);
+    }
+
+    // The threads of the pool log without waiting for each other, and the queued messages are written at exit
+    log_async_start();
+    if (!machines_read_dir(inputs[0], &machines)) return_defer(1);
+    if (machines.count == 0) {
+        nob_log(NOB_ERROR, "Directory %s doesn't contain any machine exports", inputs[0]);
+        return_defer(1);
+    }
+    if (!inventory && output_path == NULL) output_path = DEFAULT_OUTPUT_DIR;
+    if (!inventory && !mkdir_if_not_exists(output_path)) return_defer(1);
+
+    Batch batch = {.machines = &machines, .inventory = inventory, .font = inputs[1], .output_dir = output_path};
+    if (thread_count == 0) thread_count = processor_count();
+    if (thread_count > machines.count) thread_count = machines.count;
+    // The main thread works along with the threads of the pool
+    pool = thread_pool_create(thread_count - 1);
+    worker_count = thread_pool_thread_count(pool) + 1;
+    workers = calloc(worker_count, sizeof(*workers));
+    assert(workers != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < worker_count; ++i) workers[i].batch = &batch;
+    batch.workers = workers;
+
+    // Every machine gets a directory, which would otherwise be logged thousands of times
+    Nob_Log_Level log_level = nob_minimal_log_level;
+    if (nob_minimal_log_level < NOB_WARNING) nob_minimal_log_level = NOB_WARNING;
+    double start = now_seconds();
+    parallel_for(pool, 0, machines.count, 1, fleet_machine, &batch);
+    double seconds = now_seconds() - start;
+    nob_minimal_log_level = log_level;
+
+    size_t failed = atomic_load(&batch.failed);
+    size_t without_font = atomic_load(&batch.without_font);
+    nob_log(NOB_INFO, "Processed %zu machines with %zu threads in %.3f s: %.1f machines per second",
+        machines.count, worker_count, seconds, seconds > 0 ? machines.count / seconds : 0.0);
+    if (without_font > 0) nob_log(NOB_WARNING, "%zu machines don't have font %s", without_font, batch.font);
+
+    if (inventory) {
+        // Every worker counted different machines, so their counts add up
+        for (size_t i = 1; i < worker_count; ++i) inventory_merge(&workers[0].inventory, &workers[i].inventory);
+        inventory_report(&workers[0].inventory, machines.count - failed, &csv);
+        if (output_path != NULL) {
+            if (!write_entire_file(output_path, csv.items, csv.count)) return_defer(1);
+        } else {
+            fwrite(csv.items, 1, csv.count, stdout);
+        }
+    }
+    if (failed > 0) {
+        nob_log(NOB_ERROR, "%zu machines failed", failed);
+        return_defer(1);
+    }
+
+defer:
+    thread_pool_destroy(pool);
+    for (size_t i = 0; i < worker_count; ++i) {
+        sb_free(workers[i].reg);
+        sb_free(workers[i].snapshot);
+        sb_free(workers[i].path);
+        inventory_free(&workers[i].inventory);
+    }
+    sb_free(csv);
+    free(workers);
+    machines_free(&machines);
+    return result;
+}
@@ -0,0 +1,198 @@
+#define NOB_IMPLEMENTATION
+#define NOB_STRIP_PREFIX
+#include "nob.h"
+// Undefine the log error types, because it conflicts with windows.h
+#undef ERROR
+#undef INFO
+#undef WARNING
+
+#include <stdio.h>
+#include <string.h>
+
+#define REGISTRY_IMPLEMENTATION
+#include "registry.h"
+
+// Key below HKEY_LOCAL_MACHINE that the hive is loaded as by default
+#define DEFAULT_MOUNT "SOFTWARE"
+
+// Keys that are exported when none are given
+const char* default_keys[] = {
+    "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\Fonts",
+    "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontSubstitutes",
+    "SOFTWARE\\Microsoft\\Windows NT\\CurrentVersion\\FontLink\\SystemLink",
+};
+
+void log_usage(Nob_Log_Level level, const char* program) {
+    nob_log(level, "Usage: %s export <hive> [keys...] [options]", program);
+    nob_log(level, "       %s apply <hive> <patch> [options]", program);
+    nob_log(level, "export writes the values of keys in an offline registry hive file as a .reg file.");
+    nob_log(level, "The keys are paths below HKEY_LOCAL_MACHINE, like in a .reg file. Without keys, the font keys are exported.");
+    nob_log(level, "apply writes the values of a .reg file or snapshot to an offline registry hive file.");
+}
+
+void log_options(Nob_Log_Level level) {
+    nob_log(level, "Available options:");
+    nob_log(level, "  -o <file>          Write the .reg file to a file instead of stdout");
+    nob_log(level, "  --mount <key>      Key below HKEY_LOCAL_MACHINE that the hive belongs to (default: "DEFAULT_MOUNT")");
+    nob_log(level, "  --help             Shows this help message");
+}
+
+// Get the path of a key inside of the hive that is mounted at mount
+// Returns the path, or NULL if the key is not inside of the hive
+const char* hive_key_path(const char* mount, const char* path) {
+    size_t mount_len = strlen(mount);
+    if (strlen(path) < mount_len || reg_name_compare(path, mount_len, mount, mount_len) != 0) return NULL;
+    if (path[mount_len] == '\0') return path + mount_len;
+    if (path[mount_len] != '\\') return NULL;
+    return path + mount_len + 1;
+}
+
+// Write the values of the keys in a patch to a hive
+// Keys that are deleted by the patch lose all of their values, but are kept along with their subkeys
+// Returns true on success, false on failure
+bool apply_patch(Registry_Hive* hive, const char* mount, const Registry_File* patch) {
+    size_t key_count = 0;
+    size_t value_count = 0;
+    for (size_t i = 0; i < patch->keys.count; ++i) {
+        const Registry_Key* key = &patch->keys.items[i];
+        const char* path = hive_key_path(mount, key->path);
+        if (path == NULL) {
+            nob_log(NOB_WARNING, "Skipping key %s, which is not in the hive", key->path);
+            continue;
+        }
+        uint32_t offset = 0;
+        if (!reg_hive_find_key(hive, path, &offset)) {
+            // Empty keys don't need to be created
+            if (key->deleted || key->list.count == 0) continue;
+            nob_log(NOB_ERROR, "The hive doesn't contain key %s, and adding keys is not supported", key->path);
+            return false;
+        }
+
+        if (key->deleted) {
+            Registry_Value_List existing = {0};
+            bool result = reg_hive_key_list_values(hive, offset, &existing);
+            for (size_t j = 0; j < existing.count; ++j) existing.items[j].type = REG_TYPE_DELETE;
+            result = result && reg_hive_key_apply(hive, offset, existing);
+            value_count += existing.count;
+            reg_value_list_free(&existing);
+            if (!result) return false;
+        }
+        if (!reg_hive_key_apply(hive, offset, key->list)) return false;
+        value_count += key->list.count;
+        key_count += 1;
+    }
+    nob_log(NOB_INFO, "Wrote %zu values to %zu keys", value_count, key_count);
+    return true;
+}
+
+// Add the values of the keys in a hive to a .reg file
+// Returns true on success, false on failure
+bool export_keys(const Registry_Hive* hive, const char* mount, const char** keys, size_t key_count, String_Builder* reg) {
+    sb_append_cstr(reg, "Windows Registry Editor Version 5.00\n");
+    size_t value_count = 0;
+    for (size_t i = 0; i < key_count; ++i) {
+        const char* path = hive_key_path(mount, keys[i]);
+        uint32_t key = 0;
+        if (path == NULL || !reg_hive_find_key(hive, path, &key)) {
+            nob_log(NOB_WARNING, "The hive doesn't contain key %s", keys[i]);
+            continue;
+        }
+        Registry_Value_List values = {0};
+        bool result = reg_hive_key_list_values(hive, key, &values) && reg_key_add_to_file(keys[i], values, reg);
+        value_count += values.count;
+        reg_value_list_free(&values);
+        if (!result) return false;
+    }
+    nob_log(NOB_INFO, "Exported %zu values", value_count);
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int result = 0;
+    Registry_Hive hive = {0};
+    String_Builder reg = {0};
+    File_Paths keys = {0};
+    Registry_File patch = {0};
+
+    const char* program = shift(argv, argc);
+    if (argc < 1 || strcmp(argv[0], "--help") == 0) {
+        log_usage(argc < 1 ? NOB_ERROR : NOB_INFO, program);
+        log_options(argc < 1 ? NOB_ERROR : NOB_INFO);
+        return argc < 1;
+    }
+    const char* command = shift(argv, argc);
+    const bool apply = strcmp(command, "apply") == 0;
+    if (!apply && strcmp(command, "export") != 0) {
+        log_usage(NOB_ERROR, program);
+        nob_log(NOB_ERROR, "Invalid command %s", command);
+        return 1;
+    }
+
+    const char* hive_path = NULL;
+    const char* output_path = NULL;
+    const char* mount = DEFAULT_MOUNT;
+    // Parse the options
+    while (argc > 0) {
+        const char* option = shift(argv, argc);
+        if (strcmp(option, "-o") == 0 || strcmp(option, "--mount") == 0) {
+            if (argc < 1) {
+                log_usage(NOB_ERROR, program);
+                nob_log(NOB_ERROR, "Missing %s value", option);
+                return_defer(1);
+            }
+            if (option[1] == 'o') output_path = shift(argv, argc);
+            else mount = shift(argv, argc);
+        } else if (strcmp(option, "--help") == 0) {
+            log_usage(NOB_INFO, program);
+            log_options(NOB_INFO);
+            return_defer(0);
+        } else if (option[0] == '-' && option[1] != '\0') {
+            log_usage(NOB_ERROR, program);
+            log_options(NOB_ERROR);
+            nob_log(NOB_ERROR, "Invalid option %s", option);
+            return_defer(1);
+        } else if (hive_path == NULL) {
+            hive_path = option;
+        } else {
+            da_append(&keys, option);
+        }
+    }
+    if (hive_path == NULL) {
+        log_usage(NOB_ERROR, program);
+        nob_log(NOB_ERROR, "Missing hive file");
+        return_defer(1);
+    }
+
+    if (apply) {
+        if (keys.count != 1 || output_path != NULL) {
+            log_usage(NOB_ERROR, program);
+            nob_log(NOB_ERROR, "Expected a single patch file");
+            return_defer(1);
+        }
+        if (!reg_file_read(keys.items[0], &patch)) return_defer(1);
+        if (!reg_hive_open_for_writing(hive_path, &hive)) return_defer(1);
+        if (!apply_patch(&hive, mount, &patch)) {
+            nob_log(NOB_ERROR, "Hive %s was only partly changed", hive_path);
+            return_defer(1);
+        }
+        if (!reg_hive_flush(&hive)) return_defer(1);
+        return_defer(0);
+    }
+
+    if (keys.count == 0) da_append_many(&keys, default_keys, ARRAY_LEN(default_keys));
+    if (!reg_hive_open(hive_path, &hive)) return_defer(1);
+    if (!export_keys(&hive, mount, keys.items, keys.count, &reg)) return_defer(1);
+
+    if (output_path != NULL) {
+        if (!write_entire_file(output_path, reg.items, reg.count)) return_defer(1);
+    } else {
+        fwrite(reg.items, 1, reg.count, stdout);
+    }
+
+defer:
+    reg_hive_close(&hive);
+    reg_file_free(&patch);
+    da_free(keys);
+    sb_free(reg);
+    return result;
+}
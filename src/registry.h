@@ -0,0 +1,3150 @@
+// Windows registry values, and the ways winfun stores them on disk
+//
+// Requires nob.h to be included beforehand, with NOB_STRIP_PREFIX defined.
+// Works on every platform, so offline tools can use it too.
+// Doesn't use the temporary allocator of nob.h or any other global state, so different threads can work on
+// different keys and files at the same time.
+// Define REGISTRY_IMPLEMENTATION in exactly one file before including it, like nob.h.
+
+#ifndef REGISTRY_H_
+#define REGISTRY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Possible types for Registry_Value
+typedef enum {
+    REG_TYPE_STRING,
+    REG_TYPE_HEX,
+    REG_TYPE_DELETE,
+} Registry_Value_Type;
+
+// Structure that stores a Windows registry value
+// The name and the data of a REG_TYPE_STRING value can be views into a longer string, so they end at
+// name_len and data_len, or at a NUL if that comes first for the data.
+typedef struct {
+    char* name;
+    size_t name_len;
+    Registry_Value_Type type;
+    // The Windows type (REG_BINARY, REG_MULTI_SZ, ...) of a REG_TYPE_HEX value
+    uint32_t type_hex_type;
+    char* data;
+    size_t data_len;
+} Registry_Value;
+
+// List of registry values
+typedef struct {
+    Registry_Value* items;
+    size_t count;
+    size_t capacity;
+} Registry_Value_List;
+
+// A registry key below HKEY_LOCAL_MACHINE together with its values
+typedef struct {
+    const char* path;
+    Registry_Value_List list;
+    // FILETIME of the last write to the key, or 0 if it is unknown
+    uint64_t last_write_time;
+    // The key is deleted as a whole, like [-key] in a .reg file
+    bool deleted;
+} Registry_Key;
+
+// List of registry keys
+typedef struct {
+    Registry_Key* items;
+    size_t count;
+    size_t capacity;
+} Registry_Key_List;
+
+// Escape a string and add it to a string builder
+void sb_append_escaped(String_Builder* sb, const char* string);
+// Escape the first len bytes of a string and add them to a string builder
+void sb_append_escaped_len(String_Builder* sb, const char* string, size_t len);
+
+// Add a registry hex value to a string builder
+void reg_sb_append_hex(String_Builder* sb, const Registry_Value* value);
+
+// Add registry values of a key to a string builder in the form of a .reg file
+// Doesn't add a header or clear the string builder, to allow for multiple keys per file
+// Returns true on success, false on failure
+bool reg_key_add_to_file(const char* registry_path, const Registry_Value_List list, String_Builder* sb);
+
+// Add registry values of a key to a string builder in the form of a .reg file
+// Resets the string builder and adds the header
+// Returns true on success, false on failure
+bool reg_key_get_file(const char* registry_path, const Registry_Value_List list, String_Builder* sb);
+
+// Add the deletion of a whole key to a string builder in the form of a .reg file
+void reg_key_delete_add_to_file(const char* registry_path, String_Builder* sb);
+
+// Names that are shorter than this are stored in a Registry_Name_Table itself, with their NUL
+#define REG_NAME_INLINE 12
+
+typedef struct {
+    uint32_t len;
+    union {
+        char inline_name[REG_NAME_INLINE];
+        // Offset of the name in the pool, when it doesn't fit inline
+        uint32_t offset;
+    };
+} Registry_Name;
+
+// The names of registry values packed together, for loops that only look at the names
+// Going through them doesn't load the data of the values in between. Longer names are copied into a pool, each
+// followed by a NUL, instead of being allocated one by one.
+typedef struct {
+    Registry_Name* items;
+    size_t count;
+    size_t capacity;
+    String_Builder pool;
+} Registry_Name_Table;
+
+// Replace the names of a table with copies of the names of the values in a list
+// The array and the pool are sized for the list up front, so they are only allocated once.
+void reg_name_table_build(const Registry_Value_List list, Registry_Name_Table* table);
+// Get the NUL-terminated name at index, which stays valid until the table is built again
+const char* reg_name_table_get(const Registry_Name_Table* table, size_t index);
+void reg_name_table_free(Registry_Name_Table* table);
+
+// Compare two value names the way Windows does, case insensitive
+// Returns a negative number, zero or a positive number, like strcmp
+int reg_name_compare(const char* a, size_t a_len, const char* b, size_t b_len);
+
+// Get the length of the data of a REG_TYPE_STRING value, without a trailing NUL
+size_t reg_value_string_len(const Registry_Value* value);
+// Check whether two values have the same type and data
+bool reg_value_data_eq(const Registry_Value* a, const Registry_Value* b);
+// Free the names and data of values that were read from the registry or a hive, and the list itself
+void reg_value_list_free(Registry_Value_List* list);
+// Add UTF-16LE text of size bytes to a string builder as UTF-8
+void reg_utf16le_to_utf8(const void* utf16, size_t size, String_Builder* sb);
+
+// The changes between two states of a key
+typedef struct {
+    // The values that need to be written, or deleted if they are REG_TYPE_DELETE
+    Registry_Value_List patch;
+    // The values that undo the patch
+    Registry_Value_List restore;
+    // Every value of the key is deleted, so the key can be deleted as a whole
+    bool delete_key;
+    // Amount of values that are added, removed and changed by the patch
+    size_t added;
+    size_t removed;
+    size_t changed;
+} Registry_Key_Diff;
+
+// Compute the changes that turn the values in original into the values in modified
+// Values in modified that are REG_TYPE_DELETE delete the value with that name, values that aren't in
+// modified are left alone. When a name appears multiple times, the last one wins, like in a .reg file.
+// The patch keeps the order of modified, and the values in the diff refer to the names and data of original and modified.
+void reg_key_diff(const Registry_Value_List original, const Registry_Value_List modified, Registry_Key_Diff* diff);
+// Compute the changes that turn the values in original into exactly the values in target
+// Unlike reg_key_diff, values of original that aren't in target are deleted.
+// The patch keeps the order of target, followed by the deletions in the order of original.
+void reg_key_diff_states(const Registry_Value_List original, const Registry_Value_List target, Registry_Key_Diff* diff);
+// Add the patch of a diff to a string builder in the form of a .reg file
+// Adds nothing if the key doesn't change
+void reg_key_diff_add_to_file(const char* registry_path, const Registry_Key_Diff* diff, String_Builder* sb);
+void reg_key_diff_free(Registry_Key_Diff* diff);
+
+// 64-bit XXH64 hash of a buffer
+uint64_t reg_hash64(const void* data, size_t size, uint64_t seed);
+
+// A string in a Registry_Strings table
+typedef struct {
+    const char* data;
+    uint32_t len;
+    // Lower half of the XXH64 of the string
+    uint32_t hash;
+    // Offset of the string when all strings are laid out in the order of their IDs, each followed by a NUL
+    uint32_t offset;
+} Registry_String;
+
+#define REG_STRINGS_BLOCK_SIZE (64*1024)
+
+// Table of interned strings, which stores every distinct string once and gives it a 32-bit ID
+// IDs are handed out in order, starting at 0, and stay the same until the table is freed. Strings are compared
+// byte for byte, so they can also be data. They are copied into blocks that never move, so their pointers stay
+// valid as well, and two strings are equal exactly when their IDs are.
+typedef struct {
+    // The strings by ID
+    Registry_String* items;
+    size_t count;
+    size_t capacity;
+    // Open addressing hash table of IDs plus one, 0 for an empty slot
+    uint32_t* slots;
+    size_t slot_count;
+    // Current block, which starts with a pointer to the previous block
+    char* block;
+    size_t block_used;
+    size_t block_size;
+    // Sum of the lengths of all strings plus a NUL for each
+    size_t size;
+} Registry_Strings;
+
+// Add a string of len bytes to a table, copying it and a NUL if the table doesn't have it yet
+// Returns the ID of the string
+uint32_t reg_strings_intern(Registry_Strings* strings, const char* string, size_t len);
+// Find the ID of a string without adding it
+// Returns true if the table has the string, false otherwise
+bool reg_strings_find(const Registry_Strings* strings, const char* string, size_t len, uint32_t* id);
+// Get the NUL-terminated string with an ID
+#define reg_strings_get(strings, id) ((strings)->items[(id)].data)
+void reg_strings_free(Registry_Strings* strings);
+
+// Binary snapshot of registry keys
+//
+// Layout, all integers little-endian:
+//   Registry_Snapshot_Header
+//   Registry_Snapshot_Key[key_count]
+//   Registry_Snapshot_Value[value_count]
+//   String table of strings_size bytes
+//
+// Every string in the string table is followed by a NUL, so names and data can be used as C strings
+// straight from the mapped file. Equal strings are only stored once, so offsets can be shared. Loading a snapshot only maps it and checks the header.
+
+#define REG_SNAPSHOT_MAGIC "WFSNAP\r\n"
+#define REG_SNAPSHOT_VERSION 2
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t key_count;
+    uint32_t value_count;
+    uint32_t strings_size;
+    uint64_t file_size;
+    // XXH64 of everything after the header
+    uint64_t checksum;
+} Registry_Snapshot_Header;
+
+typedef struct {
+    uint64_t last_write_time;
+    uint32_t path_offset;
+    uint32_t path_len;
+    uint32_t first_value;
+    uint32_t value_count;
+} Registry_Snapshot_Key;
+
+typedef struct {
+    uint32_t name_offset;
+    uint32_t name_len;
+    uint32_t data_offset;
+    uint32_t data_len;
+    // Registry_Value_Type
+    uint32_t type;
+    uint32_t type_hex_type;
+} Registry_Snapshot_Value;
+
+// A snapshot that is mapped into memory
+typedef struct {
+    const void* base;
+    size_t size;
+    const Registry_Snapshot_Header* header;
+    const Registry_Snapshot_Key* keys;
+    const Registry_Snapshot_Value* values;
+    const char* strings;
+} Registry_Snapshot;
+
+// Serialize keys into a snapshot, replacing the contents of the string builder
+void reg_snapshot_serialize(const Registry_Key* keys, size_t key_count, String_Builder* sb);
+// Serialize keys into a snapshot file, which is only put in place once it is complete and flushed
+// Returns true on success, false on failure
+bool reg_snapshot_write(const char* path, const Registry_Key* keys, size_t key_count);
+// Map a snapshot file into memory and check its header
+// Returns true on success, false on failure
+bool reg_snapshot_load(const char* path, Registry_Snapshot* snapshot);
+// Check the checksum and all offsets of a loaded snapshot
+// This reads the whole file, so only do it when the snapshot comes from an untrusted place
+// Returns true if the snapshot is intact, false otherwise
+bool reg_snapshot_verify(const Registry_Snapshot* snapshot);
+// Unmap a snapshot, invalidating all lists that were taken from it
+void reg_snapshot_unload(Registry_Snapshot* snapshot);
+// Add the values of the key with the path of key->path in a snapshot to key->list, and set its last write time
+// The names and data of the values point into the mapped file and must not be modified or freed,
+// only the items of the list need to be freed.
+// Returns true if the key was found, false otherwise
+bool reg_snapshot_get_key(const Registry_Snapshot* snapshot, Registry_Key* key);
+
+// Compressed container for .reg files and snapshots
+//
+// Layout, all integers little-endian:
+//   Magic REG_LZ_MAGIC
+//   Blocks of at most REG_LZ_BLOCK_SIZE bytes of content, each one:
+//     uint32_t stored_size, with REG_LZ_BLOCK_STORED set if the block is stored as is
+//     uint32_t content_size
+//     uint32_t checksum, the lower 32 bits of the XXH64 of the content
+//     stored_size bytes of data, in the LZ4 block format unless the block is stored
+//   uint32_t 0, marking the end
+//
+// Blocks are independent, so compressing and decompressing a stream only needs memory for a single block.
+
+#define REG_LZ_MAGIC "WFLZ\r\n\x1a\n"
+#define REG_LZ_BLOCK_SIZE (64 * 1024)
+#define REG_LZ_BLOCK_STORED 0x80000000u
+
+// Check whether a buffer starts like a compressed container
+bool reg_lz_is_compressed(const void* data, size_t size);
+// Compress everything that can be read from in, writing the container to out
+// Returns true on success, false on failure
+bool reg_lz_compress_stream(FILE* in, FILE* out);
+// Decompress a container that is read from in, writing the content to out
+// The name is only used for error messages.
+// Returns true on success, false on failure
+bool reg_lz_decompress_stream(const char* name, FILE* in, FILE* out);
+// Compress a buffer into a file, which is only put in place once it is complete and flushed
+// Returns true on success, false on failure
+bool reg_lz_write_file(const char* path, const void* data, size_t size);
+// Decompress a container in memory, appending the content to a string builder
+// The name is only used for error messages.
+// Returns true on success, false on failure
+bool reg_lz_decompress(const char* name, const void* data, size_t size, String_Builder* sb);
+
+// The keys of a .reg file or snapshot, sorted by path
+typedef struct {
+    Registry_Key_List keys;
+    // Owns the paths, names and data of a parsed .reg file
+    char* pool;
+    // Owns the paths, names and data of a loaded snapshot
+    Registry_Snapshot snapshot;
+    // Owns the decompressed contents of a compressed snapshot, which the snapshot points into instead
+    char* buffer;
+} Registry_File;
+
+// Parse the contents of a .reg file, which may be ANSI, UTF-8 or UTF-16LE with a BOM like regedit exports
+// Keys outside of HKEY_LOCAL_MACHINE are skipped with a warning. Keys that appear multiple times are merged,
+// and deleted keys are kept with deleted set, so the result describes the state the file leaves the registry in.
+// The path is only used for error messages.
+// Returns true on success, false on failure
+bool reg_file_parse(const char* path, const char* content, size_t size, Registry_File* file);
+// Read a .reg file or a snapshot, depending on the contents of the file, which may be compressed
+// Returns true on success, false on failure
+bool reg_file_read(const char* path, Registry_File* file);
+// Find a key by its path, case insensitive
+// Returns the key, or NULL if the file doesn't contain it
+Registry_Key* reg_file_find_key(const Registry_File* file, const char* path);
+void reg_file_free(Registry_File* file);
+
+// Write-ahead journal of changes to the registry
+//
+// Layout, all integers little-endian:
+//   Registry_Journal_Header
+//   Undo snapshot of undo_size bytes, with the values of the changed names before the change,
+//     REG_TYPE_DELETE for names that didn't exist
+//   Padding to a multiple of 8 bytes
+//   Redo snapshot of redo_size bytes, with the values that are written
+//
+// The journal is flushed to disk before the registry is changed, and removed once the change is verified.
+// Every snapshot has its own checksum, so a journal that was cut short while writing it is never replayed.
+
+#define REG_JOURNAL_MAGIC "WFJRNL\r\n"
+#define REG_JOURNAL_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t undo_size;
+    uint64_t redo_size;
+} Registry_Journal_Header;
+
+// A journal that is read into memory
+typedef struct {
+    String_Builder content;
+    // The snapshots point into the content
+    Registry_Snapshot undo;
+    Registry_Snapshot redo;
+    // Both snapshots are intact. If not, the journal was cut short and the registry wasn't changed yet.
+    bool complete;
+} Registry_Journal;
+
+// Write a journal of the changes from the keys in undo to the keys in redo, and flush it to disk
+// Returns true on success, false on failure
+bool reg_journal_write(const char* path, const Registry_Key* undo, const Registry_Key* redo, size_t key_count);
+// Read a journal and check whether it is complete
+// Returns true on success, false if the file couldn't be read
+bool reg_journal_read(const char* path, Registry_Journal* journal);
+void reg_journal_free(Registry_Journal* journal);
+
+// Registry hive file in the regf format, like the SOFTWARE hive in Windows\System32\config
+//
+// Layout, all integers little-endian:
+//   Registry_Hive_Header, the base block of 4096 bytes
+//   Hive bins of bins_size bytes in total, each a multiple of 4096 bytes that starts with "hbin"
+//
+// The hive bins are split into cells, which start with their size as an int32_t that is negative when the cell
+// is allocated. Offsets of cells are relative to the first hive bin. Keys are nk cells with a list of subkeys
+// (lf, lh, li or ri cells) and a list of values, which points to vk cells. Data that fits in 4 bytes is
+// stored in the vk cell itself, and data that doesn't fit in a single cell is split over a db cell.
+// A hive is mapped into memory, so reading a few keys only touches the pages that contain their cells.
+// A hive that is opened for writing is mapped shared, so changing a value only writes the pages of the cells that change.
+// Freed cells are reused for new cells in the same hive bin as the key or in the last hive bin, and a new hive bin
+// is added at the end when neither has room.
+
+#define REG_HIVE_MAGIC "regf"
+#define REG_HIVE_BIN_MAGIC "hbin"
+#define REG_HIVE_BLOCK_SIZE 4096
+// Offset meaning that there is no cell
+#define REG_HIVE_NO_CELL 0xFFFFFFFFu
+
+typedef struct {
+    char magic[4];
+    // The sequence numbers differ while the hive is being written
+    uint32_t primary_sequence;
+    uint32_t secondary_sequence;
+    uint32_t last_write_time_low;
+    uint32_t last_write_time_high;
+    uint32_t major_version;
+    uint32_t minor_version;
+    // 0 for a hive, other values for transaction logs
+    uint32_t file_type;
+    uint32_t file_format;
+    uint32_t root;
+    uint32_t bins_size;
+    uint32_t clustering_factor;
+    uint16_t file_name[32];
+    uint8_t reserved[396];
+    // XOR of the 127 uint32_t before it
+    uint32_t checksum;
+    uint8_t reserved2[3584];
+} Registry_Hive_Header;
+
+// A hive that is mapped into memory
+typedef struct {
+    void* base;
+    size_t size;
+    Registry_Hive_Header* header;
+    // Start of the first hive bin
+    uint8_t* bins;
+    // The path of a hive that is opened for writing, to map it again when it grows
+    const char* path;
+    // The file of a hive that is opened for writing, which stays open to flush it to disk
+    Nob_Fd file;
+    // Offset of the last hive bin, or REG_HIVE_NO_CELL if it isn't known yet
+    uint32_t last_bin;
+    // The hive was changed since it was opened, and the primary sequence number is ahead
+    bool dirty;
+} Registry_Hive;
+
+// Map a hive file into memory and check its base block
+// Returns true on success, false on failure
+bool reg_hive_open(const char* path, Registry_Hive* hive);
+// Find a key by its path below the root key of the hive, case insensitive, e.g. Microsoft\Windows NT for the SOFTWARE hive
+// Returns true if the key was found, and sets key to the offset of its cell, false otherwise
+bool reg_hive_find_key(const Registry_Hive* hive, const char* path, uint32_t* key);
+// Get all of the values of the key at offset key, and add them to the Registry_Value_List result, like reg_key_list_values
+// Free the result with reg_value_list_free.
+// Returns true on success, false on failure
+bool reg_hive_key_list_values(const Registry_Hive* hive, uint32_t key, Registry_Value_List* result);
+// Map a hive file into memory for reading and writing, and check its base block
+// The path needs to stay valid until the hive is closed, and the file stays open until then.
+// Returns true on success, false on failure
+bool reg_hive_open_for_writing(const char* path, Registry_Hive* hive);
+// Write the values of a patch to the key at offset key of a hive that is opened for writing, like reg_key_apply
+// Values that are REG_TYPE_DELETE are deleted, other values are added or replaced.
+// Returns true on success, false on failure
+bool reg_hive_key_apply(Registry_Hive* hive, uint32_t key, const Registry_Value_List patch);
+// Mark the changes of a hive that is opened for writing as complete, update the checksum and flush it to disk
+// Returns true on success, false on failure
+bool reg_hive_flush(Registry_Hive* hive);
+// Unmap a hive and close its file, without flushing it
+void reg_hive_close(Registry_Hive* hive);
+
+#ifdef _WIN32
+#include <windows.h>
+
+// Query the amount of values and the last write time of the HKEY key
+// Returns true on success, false on failure
+bool reg_key_query_info(HKEY key, DWORD* amount_of_values, uint64_t* last_write_time);
+// Get the first amount_of_values values for the HKEY parent_key, and add them to the Registry_Value_List result
+// Returns true on success, false on failure
+bool reg_key_enumerate_values(HKEY parent_key, DWORD amount_of_values, Registry_Value_List* result);
+// Get all of the values for the HKEY parent_key, and add them to the Registry_Value_List result
+// Returns true on success, false on failure
+bool reg_key_list_values(HKEY parent_key, Registry_Value_List* result);
+// Write the values of a patch to the HKEY key, deleting the values that are REG_TYPE_DELETE
+// The key needs to be opened with KEY_SET_VALUE
+// Returns true on success, false on failure
+bool reg_key_apply(HKEY key, const Registry_Value_List patch);
+// Read the HKEY key back and check that applying the patch again wouldn't change anything
+// Returns true if the key matches the patch, false otherwise
+bool reg_key_verify_patch(HKEY key, const Registry_Value_List patch);
+// Write the values of every key in a snapshot to the registry below HKEY_LOCAL_MACHINE and read them back,
+// opening every key once, like reg_key_apply and reg_key_verify_patch
+// Returns true on success, false on failure
+bool reg_snapshot_apply(const Registry_Snapshot* snapshot);
+#endif // _WIN32
+
+#endif // REGISTRY_H_
+
+#ifdef REGISTRY_IMPLEMENTATION
+
+#include <time.h>
+#ifdef _WIN32
+#    include <io.h>
+#else
+#    include <sys/mman.h>
+#endif
+
+// Define REG_TRACE_EVENT(name, type, arg) before the implementation to trace the registry calls,
+// type is 'B' when a call begins and 'E' when it ends, and arg is -1 or the index of the first value of a batch
+#ifndef REG_TRACE_EVENT
+#define REG_TRACE_EVENT(name, type, arg) do {} while (0)
+#endif
+// Amount of RegEnumValueA calls that are grouped into a single trace event
+#define REG_TRACE_BATCH 64
+
+#define REG_MAX_VALUE_NAME 16383
+#define REG_MAX_VALUE_DATA 16383
+
+void sb_append_escaped(String_Builder* sb, const char* string) {
+    sb_append_escaped_len(sb, string, strlen(string));
+}
+
+void sb_append_escaped_len(String_Builder* sb, const char* string, size_t len) {
+    // Loop through all characters in the string
+    for (size_t i = 0; i < len; ++i) {
+        char chr = string[i];
+        switch (chr) {
+        // If this character is a `\`, `"` or `\n`, add an escaped character to the string builder
+        case '\\':
+            sb_append_cstr(sb, "\\\\");
+            break;
+        case '"':
+            sb_append_cstr(sb, "\\\"");
+            break;
+        case '\n':
+            sb_append_cstr(sb, "\\n");
+            break;
+        default:
+            // Otherwise, add the unmodified character
+            da_append(sb, chr);
+            break;
+        }
+    }
+}
+
+void reg_sb_append_hex(String_Builder* sb, const Registry_Value* value) {
+    assert(value->type == REG_TYPE_HEX);
+
+    static const char digits[] = "0123456789abcdef";
+
+    // The type is written in hexadecimal, e.g. hex(b) for REG_QWORD
+    char type[32];
+    snprintf(type, sizeof(type), "hex(%x):", (unsigned) value->type_hex_type);
+    sb_append_cstr(sb, type);
+    if (value->data_len == 0) return;
+
+    // Every byte takes two digits and a comma, so grow the string builder once and write into it
+    size_t hex_size = value->data_len * 3 - 1;
+    if (sb->count + hex_size > sb->capacity) {
+        if (sb->capacity == 0) sb->capacity = NOB_DA_INIT_CAP;
+        while (sb->count + hex_size > sb->capacity) sb->capacity *= 2;
+        sb->items = NOB_REALLOC(sb->items, sb->capacity);
+        NOB_ASSERT(sb->items != NULL && "Buy more RAM lol");
+    }
+    char* out = sb->items + sb->count;
+    for (size_t i = 0; i < value->data_len; ++i) {
+        unsigned char byte = (unsigned char) value->data[i];
+        if (i > 0)
+            *out++ = ',';
+        *out++ = digits[byte >> 4];
+        *out++ = digits[byte & 0xf];
+    }
+    sb->count += hex_size;
+}
+
+// Add a single value to a string builder in the form of a line of a .reg file
+static void reg__value_add_to_file(String_Builder* sb, const Registry_Value* value) {
+    // Add the value name, the default value of a key has an empty name and is written as @
+    if (value->name_len == 0) {
+        sb_append_cstr(sb, "@=");
+    } else {
+        sb_append_cstr(sb, "\"");
+        sb_append_escaped_len(sb, value->name, value->name_len);
+        sb_append_cstr(sb, "\"=");
+    }
+
+    // Add the value data
+    switch (value->type) {
+    case REG_TYPE_STRING:
+        sb_append_cstr(sb, "\"");
+        if (value->data != NULL) sb_append_escaped_len(sb, value->data, reg_value_string_len(value));
+        sb_append_cstr(sb, "\"");
+        break;
+    case REG_TYPE_HEX:
+        // REG_DWORD has a shorter form
+        if (value->type_hex_type == 4 && value->data_len == 4) {
+            const unsigned char* data = (const unsigned char*) value->data;
+            uint32_t dword = data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+            char dword_data[32];
+            snprintf(dword_data, sizeof(dword_data), "dword:%08x", (unsigned) dword);
+            sb_append_cstr(sb, dword_data);
+        } else {
+            reg_sb_append_hex(sb, value);
+        }
+        break;
+    case REG_TYPE_DELETE:
+        da_append(sb, '-');
+        break;
+    }
+
+    sb_append_cstr(sb, "\n");
+}
+
+bool reg_key_add_to_file(const char* registry_path, const Registry_Value_List list, String_Builder* sb) {
+    sb_append_cstr(sb, "\n[HKEY_LOCAL_MACHINE\\");
+    sb_append_cstr(sb, registry_path);
+    sb_append_cstr(sb, "]\n");
+    for (size_t i = 0; i < list.count; ++i) reg__value_add_to_file(sb, &list.items[i]);
+    return true;
+}
+
+bool reg_key_get_file(const char* registry_path, const Registry_Value_List list, String_Builder* sb) {
+    sb->count = 0;
+    sb_append_cstr(sb, "Windows Registry Editor Version 5.00\n");
+    return reg_key_add_to_file(registry_path, list, sb);
+}
+
+void reg_key_delete_add_to_file(const char* registry_path, String_Builder* sb) {
+    sb_append_cstr(sb, "\n[-HKEY_LOCAL_MACHINE\\");
+    sb_append_cstr(sb, registry_path);
+    sb_append_cstr(sb, "]\n");
+}
+
+void reg_name_table_build(const Registry_Value_List list, Registry_Name_Table* table) {
+    table->count = 0;
+    table->pool.count = 0;
+    size_t pool_size = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        if (list.items[i].name_len >= REG_NAME_INLINE) pool_size += list.items[i].name_len + 1;
+    }
+    assert(pool_size <= UINT32_MAX && "The pool of a name table is limited to 4 GiB");
+    if (table->capacity < list.count) {
+        table->capacity = list.count;
+        table->items = NOB_REALLOC(table->items, sizeof(*table->items) * table->capacity);
+        assert(table->items != NULL && "Buy more RAM lol");
+    }
+    if (table->pool.capacity < pool_size) {
+        table->pool.capacity = pool_size;
+        table->pool.items = NOB_REALLOC(table->pool.items, table->pool.capacity);
+        assert(table->pool.items != NULL && "Buy more RAM lol");
+    }
+
+    for (size_t i = 0; i < list.count; ++i) {
+        const Registry_Value* value = &list.items[i];
+        Registry_Name* name = &table->items[table->count++];
+        memset(name, 0, sizeof(*name));
+        name->len = (uint32_t) value->name_len;
+        if (value->name_len < REG_NAME_INLINE) {
+            memcpy(name->inline_name, value->name, value->name_len);
+        } else {
+            name->offset = (uint32_t) table->pool.count;
+            sb_append_buf(&table->pool, value->name, value->name_len);
+            sb_append_null(&table->pool);
+        }
+    }
+}
+
+const char* reg_name_table_get(const Registry_Name_Table* table, size_t index) {
+    const Registry_Name* name = &table->items[index];
+    return name->len < REG_NAME_INLINE ? name->inline_name : table->pool.items + name->offset;
+}
+
+void reg_name_table_free(Registry_Name_Table* table) {
+    NOB_FREE(table->items);
+    sb_free(table->pool);
+    memset(table, 0, sizeof(*table));
+}
+
+// Lowercase an ASCII character, without going through the locale like tolower
+static inline int reg__fold(char chr) {
+    unsigned char byte = (unsigned char) chr;
+    return byte >= 'A' && byte <= 'Z' ? byte + ('a' - 'A') : byte;
+}
+
+int reg_name_compare(const char* a, size_t a_len, const char* b, size_t b_len) {
+    size_t len = a_len < b_len ? a_len : b_len;
+    for (size_t i = 0; i < len; ++i) {
+        int chr_a = reg__fold(a[i]);
+        int chr_b = reg__fold(b[i]);
+        if (chr_a != chr_b) return chr_a - chr_b;
+    }
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+size_t reg_value_string_len(const Registry_Value* value) {
+    if (value->data == NULL) return 0;
+    // The data length may or may not include the NUL
+    size_t len = 0;
+    while (len < value->data_len && value->data[len] != '\0') ++len;
+    return len;
+}
+
+bool reg_value_data_eq(const Registry_Value* a, const Registry_Value* b) {
+    if (a->type != b->type) return false;
+    switch (a->type) {
+    case REG_TYPE_STRING: {
+        size_t len = reg_value_string_len(a);
+        return len == reg_value_string_len(b) && (len == 0 || memcmp(a->data, b->data, len) == 0);
+    }
+    case REG_TYPE_HEX:
+        return a->type_hex_type == b->type_hex_type
+            && a->data_len == b->data_len
+            && memcmp(a->data, b->data, a->data_len) == 0;
+    case REG_TYPE_DELETE:
+        return true;
+    }
+    return false;
+}
+
+void reg_value_list_free(Registry_Value_List* list) {
+    for (size_t i = 0; i < list->count; ++i) {
+        NOB_FREE(list->items[i].name);
+        NOB_FREE(list->items[i].data);
+    }
+    da_free(*list);
+    memset(list, 0, sizeof(*list));
+}
+
+// A value that is being sorted, along with its original position to keep the sort stable
+typedef struct {
+    const Registry_Value* value;
+    size_t index;
+    // Case insensitive hash of the name, so most comparisons don't need to look at the names
+    uint64_t hash;
+} Reg__Sort_Item;
+
+// 64-bit FNV-1a hash of a name, case insensitive
+static uint64_t reg__name_hash(const char* name, size_t name_len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < name_len; ++i) {
+        hash ^= (uint64_t) reg__fold(name[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Compare two items by hash, then by name
+// The order is meaningless, but equal names are next to each other and the same in every list
+static int reg__sort_item_compare_name(const Reg__Sort_Item* a, const Reg__Sort_Item* b) {
+    if (a->hash != b->hash) return (a->hash > b->hash) - (a->hash < b->hash);
+    return reg_name_compare(a->value->name, a->value->name_len, b->value->name, b->value->name_len);
+}
+
+static int reg__sort_item_compare(const void* a, const void* b) {
+    const Reg__Sort_Item* item_a = a;
+    const Reg__Sort_Item* item_b = b;
+    int result = reg__sort_item_compare_name(item_a, item_b);
+    if (result != 0) return result;
+    return (item_a->index > item_b->index) - (item_a->index < item_b->index);
+}
+
+// Sort the values of a list by name, keeping only the last value of every name
+// Returns an array of list.count items, of which *count are used, that needs to be freed
+static Reg__Sort_Item* reg__sort_unique(const Registry_Value_List list, size_t* count) {
+    Reg__Sort_Item* items = NOB_REALLOC(NULL, sizeof(*items) * (list.count > 0 ? list.count : 1));
+    NOB_ASSERT(items != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < list.count; ++i) {
+        items[i] = (Reg__Sort_Item) {
+            .value = &list.items[i],
+            .index = i,
+            .hash = reg__name_hash(list.items[i].name, list.items[i].name_len),
+        };
+    }
+    qsort(items, list.count, sizeof(*items), reg__sort_item_compare);
+
+    *count = 0;
+    for (size_t i = 0; i < list.count; ++i) {
+        // Skip this value if the next one has the same name
+        if (i + 1 < list.count && reg__sort_item_compare_name(&items[i], &items[i + 1]) == 0) continue;
+        items[(*count)++] = items[i];
+    }
+    return items;
+}
+
+// A change of the diff, along with the position it is written at
+typedef struct {
+    size_t index;
+    Registry_Value patch;
+    Registry_Value restore;
+} Reg__Diff_Item;
+
+typedef struct {
+    Reg__Diff_Item* items;
+    size_t count;
+    size_t capacity;
+} Reg__Diff_Items;
+
+static int reg__diff_item_compare(const void* a, const void* b) {
+    const Reg__Diff_Item* item_a = a;
+    const Reg__Diff_Item* item_b = b;
+    return (item_a->index > item_b->index) - (item_a->index < item_b->index);
+}
+
+static Registry_Value reg__deletion(const Registry_Value* value) {
+    return (Registry_Value) {
+        .name = value->name,
+        .name_len = value->name_len,
+        .type = REG_TYPE_DELETE,
+    };
+}
+
+// Compute a diff with a sorted merge of both lists
+// If delete_missing is set, values that are only in original are deleted
+static void reg__key_diff(const Registry_Value_List original, const Registry_Value_List modified, bool delete_missing, Registry_Key_Diff* diff) {
+    size_t original_count = 0;
+    size_t modified_count = 0;
+    Reg__Sort_Item* original_items = reg__sort_unique(original, &original_count);
+    Reg__Sort_Item* modified_items = reg__sort_unique(modified, &modified_count);
+    Reg__Diff_Items changes = {0};
+
+    // Walk through both sorted lists at the same time
+    size_t i = 0;
+    for (size_t j = 0; j < modified_count; ++j) {
+        const Registry_Value* value = modified_items[j].value;
+        while (i < original_count && reg__sort_item_compare_name(&original_items[i], &modified_items[j]) < 0) {
+            // Values that are only in the original list are left alone, unless they need to be deleted
+            if (delete_missing) {
+                const Registry_Value* missing = original_items[i].value;
+                Reg__Diff_Item change = {modified.count + original_items[i].index, reg__deletion(missing), *missing};
+                da_append(&changes, change);
+                diff->removed += 1;
+            }
+            ++i;
+        }
+        const Registry_Value* existing = NULL;
+        if (i < original_count && reg__sort_item_compare_name(&original_items[i], &modified_items[j]) == 0) {
+            existing = original_items[i].value;
+            ++i;
+        }
+
+        if (value->type == REG_TYPE_DELETE) {
+            // Deleting a value that doesn't exist doesn't change anything
+            if (existing == NULL) continue;
+            Reg__Diff_Item change = {modified_items[j].index, reg__deletion(existing), *existing};
+            da_append(&changes, change);
+            diff->removed += 1;
+        } else {
+            if (existing != NULL && reg_value_data_eq(existing, value)) continue;
+            Reg__Diff_Item change = {
+                .index = modified_items[j].index,
+                .patch = *value,
+                .restore = existing != NULL ? *existing : reg__deletion(value),
+            };
+            da_append(&changes, change);
+            if (existing != NULL) diff->changed += 1;
+            else diff->added += 1;
+        }
+    }
+    for (; delete_missing && i < original_count; ++i) {
+        const Registry_Value* missing = original_items[i].value;
+        Reg__Diff_Item change = {modified.count + original_items[i].index, reg__deletion(missing), *missing};
+        da_append(&changes, change);
+        diff->removed += 1;
+    }
+    diff->delete_key = !delete_missing && original_count > 0 && diff->removed == original_count && diff->added + diff->changed == 0;
+
+    // Put the changes back into the order of the lists
+    qsort(changes.items, changes.count, sizeof(*changes.items), reg__diff_item_compare);
+    for (size_t k = 0; k < changes.count; ++k) {
+        da_append(&diff->patch, changes.items[k].patch);
+        da_append(&diff->restore, changes.items[k].restore);
+    }
+
+    da_free(changes);
+    NOB_FREE(original_items);
+    NOB_FREE(modified_items);
+}
+
+void reg_key_diff(const Registry_Value_List original, const Registry_Value_List modified, Registry_Key_Diff* diff) {
+    reg__key_diff(original, modified, false, diff);
+}
+
+void reg_key_diff_states(const Registry_Value_List original, const Registry_Value_List target, Registry_Key_Diff* diff) {
+    reg__key_diff(original, target, true, diff);
+}
+
+void reg_key_diff_add_to_file(const char* registry_path, const Registry_Key_Diff* diff, String_Builder* sb) {
+    if (diff->delete_key) {
+        reg_key_delete_add_to_file(registry_path, sb);
+    } else if (diff->patch.count > 0) {
+        reg_key_add_to_file(registry_path, diff->patch, sb);
+    }
+}
+
+void reg_key_diff_free(Registry_Key_Diff* diff) {
+    da_free(diff->patch);
+    da_free(diff->restore);
+    memset(diff, 0, sizeof(*diff));
+}
+
+#define REG__PRIME64_1 0x9E3779B185EBCA87ULL
+#define REG__PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define REG__PRIME64_3 0x165667B19E3779F9ULL
+#define REG__PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define REG__PRIME64_5 0x27D4EB2F165667C5ULL
+
+static uint64_t reg__rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t reg__read64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t reg__read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t reg__xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * REG__PRIME64_2;
+    acc = reg__rotl64(acc, 31);
+    return acc * REG__PRIME64_1;
+}
+
+static uint64_t reg__xxh64_merge(uint64_t acc, uint64_t value) {
+    acc ^= reg__xxh64_round(0, value);
+    return acc * REG__PRIME64_1 + REG__PRIME64_4;
+}
+
+uint64_t reg_hash64(const void* data, size_t size, uint64_t seed) {
+    const unsigned char* p = data;
+    const unsigned char* end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + REG__PRIME64_1 + REG__PRIME64_2;
+        uint64_t v2 = seed + REG__PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - REG__PRIME64_1;
+        // Consume 32-byte stripes with four independent accumulators
+        do {
+            v1 = reg__xxh64_round(v1, reg__read64(p));      p += 8;
+            v2 = reg__xxh64_round(v2, reg__read64(p));      p += 8;
+            v3 = reg__xxh64_round(v3, reg__read64(p));      p += 8;
+            v4 = reg__xxh64_round(v4, reg__read64(p));      p += 8;
+        } while (p + 32 <= end);
+
+        hash = reg__rotl64(v1, 1) + reg__rotl64(v2, 7) + reg__rotl64(v3, 12) + reg__rotl64(v4, 18);
+        hash = reg__xxh64_merge(hash, v1);
+        hash = reg__xxh64_merge(hash, v2);
+        hash = reg__xxh64_merge(hash, v3);
+        hash = reg__xxh64_merge(hash, v4);
+    } else {
+        hash = seed + REG__PRIME64_5;
+    }
+
+    hash += (uint64_t) size;
+
+    // Consume the remaining bytes
+    for (; p + 8 <= end; p += 8) {
+        hash ^= reg__xxh64_round(0, reg__read64(p));
+        hash = reg__rotl64(hash, 27) * REG__PRIME64_1 + REG__PRIME64_4;
+    }
+    if (p + 4 <= end) {
+        hash ^= (uint64_t) reg__read32(p) * REG__PRIME64_1;
+        hash = reg__rotl64(hash, 23) * REG__PRIME64_2 + REG__PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        hash ^= (*p) * REG__PRIME64_5;
+        hash = reg__rotl64(hash, 11) * REG__PRIME64_1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= REG__PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= REG__PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+// Find the slot of a string in the hash table of a table, or the empty slot it would go in
+// Returns true if the table has the string, false otherwise
+static bool reg__strings_slot(const Registry_Strings* strings, const char* string, size_t len, uint32_t hash, size_t* slot) {
+    size_t mask = strings->slot_count - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        uint32_t id = strings->slots[i];
+        *slot = i;
+        if (id == 0) return false;
+        const Registry_String* item = &strings->items[id - 1];
+        if (item->hash == hash && item->len == len && memcmp(item->data, string, len) == 0) return true;
+    }
+}
+
+// Double the hash table of a table, or create it
+static void reg__strings_grow(Registry_Strings* strings) {
+    size_t slot_count = strings->slot_count == 0 ? 256 : strings->slot_count * 2;
+    uint32_t* slots = NOB_REALLOC(NULL, sizeof(*slots) * slot_count);
+    assert(slots != NULL && "Buy more RAM lol");
+    memset(slots, 0, sizeof(*slots) * slot_count);
+    for (size_t id = 0; id < strings->count; ++id) {
+        size_t i = strings->items[id].hash & (slot_count - 1);
+        while (slots[i] != 0) i = (i + 1) & (slot_count - 1);
+        slots[i] = (uint32_t) id + 1;
+    }
+    NOB_FREE(strings->slots);
+    strings->slots = slots;
+    strings->slot_count = slot_count;
+}
+
+uint32_t reg_strings_intern(Registry_Strings* strings, const char* string, size_t len) {
+    // Keep the hash table at most half full
+    if ((strings->count + 1) * 2 > strings->slot_count) reg__strings_grow(strings);
+    uint32_t hash = (uint32_t) reg_hash64(string, len, 0);
+    size_t slot;
+    if (reg__strings_slot(strings, string, len, hash, &slot)) return strings->slots[slot] - 1;
+
+    // Start a new block when the string doesn't fit, which is bigger than usual for long strings
+    if (strings->block == NULL || strings->block_used + len + 1 > strings->block_size) {
+        size_t block_size = sizeof(char*) + len + 1;
+        if (block_size < REG_STRINGS_BLOCK_SIZE) block_size = REG_STRINGS_BLOCK_SIZE;
+        char* block = NOB_REALLOC(NULL, block_size);
+        assert(block != NULL && "Buy more RAM lol");
+        memcpy(block, &strings->block, sizeof(char*));
+        strings->block = block;
+        strings->block_used = sizeof(char*);
+        strings->block_size = block_size;
+    }
+    char* data = strings->block + strings->block_used;
+    memcpy(data, string, len);
+    data[len] = '\0';
+    strings->block_used += len + 1;
+
+    Registry_String item = {.data = data, .len = (uint32_t) len, .hash = hash, .offset = (uint32_t) strings->size};
+    da_append(strings, item);
+    strings->size += len + 1;
+    strings->slots[slot] = (uint32_t) strings->count;
+    return (uint32_t) strings->count - 1;
+}
+
+bool reg_strings_find(const Registry_Strings* strings, const char* string, size_t len, uint32_t* id) {
+    size_t slot;
+    if (strings->slot_count == 0) return false;
+    if (!reg__strings_slot(strings, string, len, (uint32_t) reg_hash64(string, len, 0), &slot)) return false;
+    *id = strings->slots[slot] - 1;
+    return true;
+}
+
+void reg_strings_free(Registry_Strings* strings) {
+    while (strings->block != NULL) {
+        char* previous;
+        memcpy(&previous, strings->block, sizeof(char*));
+        NOB_FREE(strings->block);
+        strings->block = previous;
+    }
+    NOB_FREE(strings->slots);
+    da_free(*strings);
+    memset(strings, 0, sizeof(*strings));
+}
+
+// Add a string to the string table of a snapshot that is being serialized
+// Returns the offset of the string in the string table, which is shared with equal strings
+static uint32_t reg__snapshot_add_string(Registry_Strings* strings, const char* string, size_t len) {
+    uint32_t id = reg_strings_intern(strings, string, len);
+    return strings->items[id].offset;
+}
+
+void reg_snapshot_serialize(const Registry_Key* keys, size_t key_count, String_Builder* sb) {
+    Registry_Strings strings = {0};
+    size_t value_count = 0;
+    for (size_t i = 0; i < key_count; ++i) value_count += keys[i].list.count;
+
+    sb->count = 0;
+    Registry_Snapshot_Header header = {
+        .version = REG_SNAPSHOT_VERSION,
+        .key_count = (uint32_t) key_count,
+        .value_count = (uint32_t) value_count,
+    };
+    memcpy(header.magic, REG_SNAPSHOT_MAGIC, sizeof(header.magic));
+    // The header is filled in once the size and checksum are known
+    sb_append_buf(sb, &header, sizeof(header));
+
+    // Add the key table
+    uint32_t first_value = 0;
+    for (size_t i = 0; i < key_count; ++i) {
+        size_t path_len = strlen(keys[i].path);
+        Registry_Snapshot_Key key = {
+            .last_write_time = keys[i].last_write_time,
+            .path_offset = reg__snapshot_add_string(&strings, keys[i].path, path_len),
+            .path_len = (uint32_t) path_len,
+            .first_value = first_value,
+            .value_count = (uint32_t) keys[i].list.count,
+        };
+        sb_append_buf(sb, &key, sizeof(key));
+        first_value += key.value_count;
+    }
+
+    // Add the value table
+    for (size_t i = 0; i < key_count; ++i) {
+        for (size_t j = 0; j < keys[i].list.count; ++j) {
+            const Registry_Value* item = &keys[i].list.items[j];
+            Registry_Snapshot_Value value = {
+                .name_offset = reg__snapshot_add_string(&strings, item->name, item->name_len),
+                .name_len = (uint32_t) item->name_len,
+                .data_offset = reg__snapshot_add_string(&strings, item->data != NULL ? item->data : "", item->data_len),
+                .data_len = (uint32_t) item->data_len,
+                .type = item->type,
+                .type_hex_type = item->type_hex_type,
+            };
+            sb_append_buf(sb, &value, sizeof(value));
+        }
+    }
+
+    // Add the string table in the order of the IDs, which is the order of the offsets, and finish the header
+    for (size_t i = 0; i < strings.count; ++i) {
+        sb_append_buf(sb, strings.items[i].data, strings.items[i].len + 1);
+    }
+    Registry_Snapshot_Header* final_header = (Registry_Snapshot_Header*) sb->items;
+    final_header->strings_size = (uint32_t) strings.size;
+    final_header->file_size = sb->count;
+    final_header->checksum = reg_hash64(sb->items + sizeof(header), sb->count - sizeof(header), 0);
+    reg_strings_free(&strings);
+}
+
+bool reg_snapshot_write(const char* path, const Registry_Key* keys, size_t key_count) {
+    String_Builder sb = {0};
+    reg_snapshot_serialize(keys, key_count, &sb);
+    bool result = write_entire_file_atomic(path, sb.items, sb.count);
+    sb_free(sb);
+    return result;
+}
+
+// Open a file for reading and writing, without truncating it
+// Returns the file on success, NOB_INVALID_FD on failure
+static Nob_Fd reg__open_file_shared(const char* path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, nob_win32_error_message(GetLastError()));
+    }
+    return file;
+#else
+    int fd = open(path, O_RDWR);
+    if (fd < 0) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, strerror(errno));
+    }
+    return fd;
+#endif // _WIN32
+}
+
+// Map a whole file that is opened for reading and writing into memory, so writes to the memory end up in the file
+// The file is grown to min_size bytes if it is smaller, and stays open. It is unmapped with unmap_file, like a
+// read-only mapping.
+// Returns true on success, false on failure
+static bool reg__map_file_shared(const char* path, Nob_Fd file, size_t min_size, void** base, size_t* size) {
+#ifdef _WIN32
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size)) {
+        nob_log(NOB_ERROR, "Could not get the size of file %s: %s", path, nob_win32_error_message(GetLastError()));
+        return false;
+    }
+    if ((uint64_t) file_size.QuadPart < min_size) file_size.QuadPart = min_size;
+    // Mapping more than the size of the file grows it
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD) (file_size.QuadPart >> 32), (DWORD) file_size.QuadPart, NULL);
+    if (mapping == NULL) {
+        nob_log(NOB_ERROR, "Could not map file %s: %s", path, nob_win32_error_message(GetLastError()));
+        return false;
+    }
+    *base = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+    CloseHandle(mapping);
+    if (*base == NULL) {
+        nob_log(NOB_ERROR, "Could not map file %s: %s", path, nob_win32_error_message(GetLastError()));
+        return false;
+    }
+    *size = (size_t) file_size.QuadPart;
+    return true;
+#else
+    struct stat statbuf;
+    if (fstat(file, &statbuf) < 0) {
+        nob_log(NOB_ERROR, "Could not get the size of file %s: %s", path, strerror(errno));
+        return false;
+    }
+    size_t file_size = (size_t) statbuf.st_size;
+    if (file_size < min_size) {
+        if (ftruncate(file, min_size) < 0) {
+            nob_log(NOB_ERROR, "Could not grow file %s: %s", path, strerror(errno));
+            return false;
+        }
+        file_size = min_size;
+    }
+    *base = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (*base == MAP_FAILED) {
+        nob_log(NOB_ERROR, "Could not map file %s: %s", path, strerror(errno));
+        return false;
+    }
+    *size = file_size;
+    return true;
+#endif // _WIN32
+}
+
+// Write the changed pages of a shared mapping of a file to disk, and wait until they are there
+// Flushing the view only starts writing the pages on Windows, and msync() doesn't write the size of a file that
+// grew, so the file is flushed as well.
+// Returns true on success, false on failure
+static bool reg__flush_mapping(const char* path, Nob_Fd file, void* base, size_t size) {
+#ifdef _WIN32
+    bool result = FlushViewOfFile(base, size) && FlushFileBuffers(file);
+    if (!result) nob_log(NOB_ERROR, "Could not flush file %s: %s", path, nob_win32_error_message(GetLastError()));
+#else
+    bool result = msync(base, size, MS_SYNC) == 0 && fsync(file) == 0;
+    if (!result) nob_log(NOB_ERROR, "Could not flush file %s: %s", path, strerror(errno));
+#endif // _WIN32
+    return result;
+}
+
+// Upper bound of the size of a compressed LZ4 block
+#define REG__LZ_BOUND(size) ((size) + (size) / 255 + 16)
+// Size of the header of every block in a container, and an upper bound of a whole block with its header
+#define REG__LZ_BLOCK_HEADER_SIZE 12
+#define REG__LZ_ENCODED_BOUND (REG__LZ_BLOCK_HEADER_SIZE + REG__LZ_BOUND(REG_LZ_BLOCK_SIZE))
+#define REG__LZ_HASH_LOG 12
+// The last match has to start at least this many bytes before the end of a block
+#define REG__LZ_MF_LIMIT 12
+// The last bytes of a block are always literals
+#define REG__LZ_LAST_LITERALS 5
+
+static uint32_t reg__lz_hash(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - REG__LZ_HASH_LOG);
+}
+
+// Write a length that doesn't fit in the token, as a run of 255s and a remainder
+static unsigned char* reg__lz_write_length(unsigned char* out, size_t length) {
+    for (; length >= 255; length -= 255) *out++ = 255;
+    *out++ = (unsigned char) length;
+    return out;
+}
+
+// Write a sequence of literals, followed by a match unless match_length is 0
+static unsigned char* reg__lz_write_sequence(unsigned char* out, const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length) {
+    unsigned char* token = out++;
+    *token = (unsigned char) ((literal_length >= 15 ? 15 : literal_length) << 4);
+    if (literal_length >= 15) out = reg__lz_write_length(out, literal_length - 15);
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+    if (match_length == 0) return out;
+
+    *out++ = (unsigned char) offset;
+    *out++ = (unsigned char) (offset >> 8);
+    match_length -= 4;
+    *token |= (unsigned char) (match_length >= 15 ? 15 : match_length);
+    if (match_length >= 15) out = reg__lz_write_length(out, match_length - 15);
+    return out;
+}
+
+// Compress a block into the LZ4 block format, with a greedy search through a hash table of recent positions
+// out needs to hold REG__LZ_BOUND(size) bytes
+// Returns the compressed size
+static size_t reg__lz_compress_block(const unsigned char* in, size_t size, unsigned char* out) {
+    uint32_t table[1 << REG__LZ_HASH_LOG] = {0};
+    unsigned char* op = out;
+    size_t anchor = 0;
+    if (size > REG__LZ_MF_LIMIT) {
+        size_t limit = size - REG__LZ_MF_LIMIT;
+        size_t match_limit = size - REG__LZ_LAST_LITERALS;
+        size_t misses = 0;
+        size_t ip = 0;
+        while (ip < limit) {
+            uint32_t sequence = reg__read32(in + ip);
+            uint32_t hash = reg__lz_hash(sequence);
+            size_t candidate = table[hash];
+            table[hash] = (uint32_t) ip;
+            if (candidate >= ip || ip - candidate > 0xFFFF || reg__read32(in + candidate) != sequence) {
+                // Skip faster through data that doesn't compress
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            size_t match_length = 4;
+            while (ip + match_length < match_limit && in[candidate + match_length] == in[ip + match_length]) ++match_length;
+            op = reg__lz_write_sequence(op, in + anchor, ip - anchor, ip - candidate, match_length);
+            ip += match_length;
+            anchor = ip;
+        }
+    }
+    op = reg__lz_write_sequence(op, in + anchor, size - anchor, 0, 0);
+    return op - out;
+}
+
+// Read a length that didn't fit in the token
+// Returns false if the input ends first
+static bool reg__lz_read_length(const unsigned char** ip, const unsigned char* end, size_t* length) {
+    unsigned char byte;
+    do {
+        if (*ip >= end) return false;
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+// Decompress a block in the LZ4 block format, checking every read and write against the bounds
+// Returns true if the block decompresses to exactly size bytes, false otherwise
+static bool reg__lz_decompress_block(const unsigned char* in, size_t in_size, unsigned char* out, size_t size) {
+    const unsigned char* ip = in;
+    const unsigned char* end = in + in_size;
+    unsigned char* op = out;
+    unsigned char* out_end = out + size;
+    while (ip < end) {
+        unsigned char token = *ip++;
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !reg__lz_read_length(&ip, end, &literal_length)) return false;
+        if (literal_length > (size_t) (end - ip) || literal_length > (size_t) (out_end - op)) return false;
+        // Short runs are copied with a single fixed-size copy when there is room to overshoot
+        if (literal_length <= 16 && end - ip >= 16 && out_end - op >= 16) {
+            memcpy(op, ip, 16);
+        } else {
+            memcpy(op, ip, literal_length);
+        }
+        ip += literal_length;
+        op += literal_length;
+        // The last sequence only has literals
+        if (ip == end) break;
+
+        if (end - ip < 2) return false;
+        size_t offset = ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && !reg__lz_read_length(&ip, end, &match_length)) return false;
+        match_length += 4;
+        if (offset == 0 || offset > (size_t) (op - out) || match_length > (size_t) (out_end - op)) return false;
+
+        const unsigned char* match = op - offset;
+        if (offset >= 8 && (size_t) (out_end - op) >= match_length + 8) {
+            // Copy 8 bytes at a time, the overshoot is overwritten by what comes next
+            for (size_t i = 0; i < match_length; i += 8) memcpy(op + i, match + i, 8);
+            op += match_length;
+        } else if (offset >= match_length) {
+            memcpy(op, match, match_length);
+            op += match_length;
+        } else {
+            // The match overlaps with itself, which repeats the last offset bytes
+            for (size_t i = 0; i < match_length; ++i) *op++ = match[i];
+        }
+    }
+    return op == out_end;
+}
+
+static void reg__lz_write32(unsigned char* p, uint32_t value) {
+    p[0] = (unsigned char) value;
+    p[1] = (unsigned char) (value >> 8);
+    p[2] = (unsigned char) (value >> 16);
+    p[3] = (unsigned char) (value >> 24);
+}
+
+static uint32_t reg__lz_read32_le(const unsigned char* p) {
+    return p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+// Compress a block together with its header, out needs to hold REG__LZ_ENCODED_BOUND bytes
+// Returns the size of the block in out
+static size_t reg__lz_encode_block(const unsigned char* block, size_t size, unsigned char* out) {
+    unsigned char* payload = out + REG__LZ_BLOCK_HEADER_SIZE;
+    size_t compressed_size = reg__lz_compress_block(block, size, payload);
+    uint32_t stored_size = (uint32_t) compressed_size;
+    // Store blocks that don't get smaller as they are
+    if (compressed_size >= size) {
+        memcpy(payload, block, size);
+        stored_size = (uint32_t) size | REG_LZ_BLOCK_STORED;
+        compressed_size = size;
+    }
+    reg__lz_write32(out, stored_size);
+    reg__lz_write32(out + 4, (uint32_t) size);
+    reg__lz_write32(out + 8, (uint32_t) reg_hash64(block, size, 0));
+    return REG__LZ_BLOCK_HEADER_SIZE + compressed_size;
+}
+
+// Check the header of a block
+// Returns true if it is valid, false otherwise
+static bool reg__lz_check_block_header(const char* name, uint32_t stored_size, uint32_t content_size) {
+    uint32_t size = stored_size & ~REG_LZ_BLOCK_STORED;
+    bool stored = (stored_size & REG_LZ_BLOCK_STORED) != 0;
+    if (content_size == 0 || content_size > REG_LZ_BLOCK_SIZE
+        || size > REG__LZ_BOUND(REG_LZ_BLOCK_SIZE) || (stored && size != content_size)
+    ) {
+        nob_log(NOB_ERROR, "%s has an invalid block", name);
+        return false;
+    }
+    return true;
+}
+
+// Decompress the data of a block into out, which holds content_size bytes, and check its checksum
+// Returns true on success, false on failure
+static bool reg__lz_read_block(const char* name, uint32_t stored_size, uint32_t content_size, uint32_t checksum, const unsigned char* data, unsigned char* out) {
+    if (stored_size & REG_LZ_BLOCK_STORED) {
+        memcpy(out, data, content_size);
+    } else if (!reg__lz_decompress_block(data, stored_size, out, content_size)) {
+        nob_log(NOB_ERROR, "%s has a corrupted block", name);
+        return false;
+    }
+    if ((uint32_t) reg_hash64(out, content_size, 0) != checksum) {
+        nob_log(NOB_ERROR, "%s has a block with a wrong checksum", name);
+        return false;
+    }
+    return true;
+}
+
+bool reg_lz_is_compressed(const void* data, size_t size) {
+    return size >= sizeof(REG_LZ_MAGIC) - 1 && memcmp(data, REG_LZ_MAGIC, sizeof(REG_LZ_MAGIC) - 1) == 0;
+}
+
+bool reg_lz_compress_stream(FILE* in, FILE* out) {
+    bool result = true;
+    unsigned char* block = NOB_REALLOC(NULL, REG_LZ_BLOCK_SIZE);
+    unsigned char* scratch = NOB_REALLOC(NULL, REG__LZ_ENCODED_BOUND);
+    NOB_ASSERT(block != NULL && scratch != NULL && "Buy more RAM lol");
+
+    if (fwrite(REG_LZ_MAGIC, 1, sizeof(REG_LZ_MAGIC) - 1, out) != sizeof(REG_LZ_MAGIC) - 1) return_defer(false);
+    while (true) {
+        size_t size = fread(block, 1, REG_LZ_BLOCK_SIZE, in);
+        if (size == 0) break;
+        size_t encoded_size = reg__lz_encode_block(block, size, scratch);
+        if (fwrite(scratch, 1, encoded_size, out) != encoded_size) return_defer(false);
+    }
+    if (ferror(in)) {
+        nob_log(NOB_ERROR, "Couldn't read the input to compress: %s", strerror(errno));
+        return_defer(false);
+    }
+    unsigned char end[4] = {0};
+    if (fwrite(end, 1, sizeof(end), out) != sizeof(end)) return_defer(false);
+
+defer:
+    if (!result && ferror(out)) nob_log(NOB_ERROR, "Couldn't write the compressed output: %s", strerror(errno));
+    NOB_FREE(block);
+    NOB_FREE(scratch);
+    return result;
+}
+
+bool reg_lz_decompress_stream(const char* name, FILE* in, FILE* out) {
+    bool result = true;
+    unsigned char* data = NOB_REALLOC(NULL, REG__LZ_BOUND(REG_LZ_BLOCK_SIZE));
+    unsigned char* block = NOB_REALLOC(NULL, REG_LZ_BLOCK_SIZE);
+    NOB_ASSERT(block != NULL && data != NULL && "Buy more RAM lol");
+
+    char magic[sizeof(REG_LZ_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) || !reg_lz_is_compressed(magic, sizeof(magic))) {
+        nob_log(NOB_ERROR, "%s is not compressed", name);
+        return_defer(false);
+    }
+    while (true) {
+        unsigned char header[12];
+        if (fread(header, 1, 4, in) != 4) {
+            nob_log(NOB_ERROR, "%s is truncated", name);
+            return_defer(false);
+        }
+        uint32_t stored_size = reg__lz_read32_le(header);
+        if (stored_size == 0) break;
+        if (fread(header + 4, 1, 8, in) != 8) {
+            nob_log(NOB_ERROR, "%s is truncated", name);
+            return_defer(false);
+        }
+        uint32_t content_size = reg__lz_read32_le(header + 4);
+        if (!reg__lz_check_block_header(name, stored_size, content_size)) return_defer(false);
+        size_t size = stored_size & ~REG_LZ_BLOCK_STORED;
+        if (fread(data, 1, size, in) != size) {
+            nob_log(NOB_ERROR, "%s is truncated", name);
+            return_defer(false);
+        }
+        if (!reg__lz_read_block(name, stored_size, content_size, reg__lz_read32_le(header + 8), data, block)) return_defer(false);
+        if (fwrite(block, 1, content_size, out) != content_size) {
+            nob_log(NOB_ERROR, "Couldn't write the decompressed output: %s", strerror(errno));
+            return_defer(false);
+        }
+    }
+
+defer:
+    NOB_FREE(data);
+    NOB_FREE(block);
+    return result;
+}
+
+bool reg_lz_write_file(const char* path, const void* data, size_t size) {
+    File_Writer* writer = file_writer_open(path);
+    if (writer == NULL) return false;
+    unsigned char* scratch = NOB_REALLOC(NULL, REG__LZ_ENCODED_BOUND);
+    NOB_ASSERT(scratch != NULL && "Buy more RAM lol");
+
+    // Every block is compressed while the blocks before it are being written
+    bool result = file_writer_write(writer, REG_LZ_MAGIC, sizeof(REG_LZ_MAGIC) - 1);
+    for (size_t offset = 0; result && offset < size; offset += REG_LZ_BLOCK_SIZE) {
+        size_t block_size = size - offset < REG_LZ_BLOCK_SIZE ? size - offset : REG_LZ_BLOCK_SIZE;
+        size_t encoded_size = reg__lz_encode_block((const unsigned char*) data + offset, block_size, scratch);
+        result = file_writer_write(writer, scratch, encoded_size);
+    }
+    unsigned char end[4] = {0};
+    result = result && file_writer_write(writer, end, sizeof(end));
+    if (result) {
+        result = file_writer_close(writer);
+    } else {
+        file_writer_abort(writer);
+    }
+    NOB_FREE(scratch);
+    return result;
+}
+
+bool reg_lz_decompress(const char* name, const void* data, size_t size, String_Builder* sb) {
+    const unsigned char* p = (const unsigned char*) data + sizeof(REG_LZ_MAGIC) - 1;
+    const unsigned char* end = (const unsigned char*) data + size;
+    if (!reg_lz_is_compressed(data, size)) {
+        nob_log(NOB_ERROR, "%s is not compressed", name);
+        return false;
+    }
+    while (true) {
+        if (end - p < 4) {
+            nob_log(NOB_ERROR, "%s is truncated", name);
+            return false;
+        }
+        uint32_t stored_size = reg__lz_read32_le(p);
+        if (stored_size == 0) return true;
+        if (end - p < 12) {
+            nob_log(NOB_ERROR, "%s is truncated", name);
+            return false;
+        }
+        uint32_t content_size = reg__lz_read32_le(p + 4);
+        uint32_t checksum = reg__lz_read32_le(p + 8);
+        p += 12;
+        if (!reg__lz_check_block_header(name, stored_size, content_size)) return false;
+        size_t block_size = stored_size & ~REG_LZ_BLOCK_STORED;
+        if ((size_t) (end - p) < block_size) {
+            nob_log(NOB_ERROR, "%s is truncated", name);
+            return false;
+        }
+
+        // Decompress straight into the string builder
+        if (sb->count + content_size > sb->capacity) {
+            if (sb->capacity == 0) sb->capacity = NOB_DA_INIT_CAP;
+            while (sb->count + content_size > sb->capacity) sb->capacity *= 2;
+            sb->items = NOB_REALLOC(sb->items, sb->capacity);
+            NOB_ASSERT(sb->items != NULL && "Buy more RAM lol");
+        }
+        if (!reg__lz_read_block(name, stored_size, content_size, checksum, p, (unsigned char*) sb->items + sb->count)) return false;
+        sb->count += content_size;
+        p += block_size;
+    }
+}
+
+// Check the header of a snapshot of which base and size are set, and set up the tables
+// Returns true on success, false on failure
+static bool reg__snapshot_open(const char* path, Registry_Snapshot* snapshot) {
+    const Registry_Snapshot_Header* header = snapshot->base;
+    if (snapshot->size < sizeof(*header) || memcmp(header->magic, REG_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        nob_log(NOB_ERROR, "%s is not a snapshot", path);
+        return false;
+    }
+    if (header->version != REG_SNAPSHOT_VERSION) {
+        nob_log(NOB_ERROR, "Unsupported snapshot version %u in %s", header->version, path);
+        return false;
+    }
+    uint64_t expected_size = sizeof(*header)
+                           + (uint64_t) header->key_count * sizeof(Registry_Snapshot_Key)
+                           + (uint64_t) header->value_count * sizeof(Registry_Snapshot_Value)
+                           + header->strings_size;
+    if (header->file_size != snapshot->size || expected_size != snapshot->size) {
+        nob_log(NOB_ERROR, "Snapshot %s is truncated", path);
+        return false;
+    }
+
+    snapshot->header = header;
+    snapshot->keys = (const Registry_Snapshot_Key*) (header + 1);
+    snapshot->values = (const Registry_Snapshot_Value*) (snapshot->keys + header->key_count);
+    snapshot->strings = (const char*) (snapshot->values + header->value_count);
+    return true;
+}
+
+bool reg_snapshot_load(const char* path, Registry_Snapshot* snapshot) {
+    memset(snapshot, 0, sizeof(*snapshot));
+    String_View view;
+    if (!map_file(path, &view, MAP_DEFAULT)) return false;
+    snapshot->base = view.data;
+    snapshot->size = view.count;
+    if (!reg__snapshot_open(path, snapshot)) {
+        reg_snapshot_unload(snapshot);
+        return false;
+    }
+    return true;
+}
+
+// Check that the string of len bytes at offset is inside of the string table of a snapshot, followed by its NUL
+// The strings are used as C strings, so without the NUL they would be read past the end of the table.
+static bool reg__snapshot_string_is_valid(const Registry_Snapshot* snapshot, uint32_t offset, uint32_t len) {
+    uint64_t end = (uint64_t) offset + len;
+    return end < snapshot->header->strings_size && snapshot->strings[end] == '\0';
+}
+
+bool reg_snapshot_verify(const Registry_Snapshot* snapshot) {
+    const Registry_Snapshot_Header* header = snapshot->header;
+    const char* body = (const char*) snapshot->base + sizeof(*header);
+    if (reg_hash64(body, snapshot->size - sizeof(*header), 0) != header->checksum) return false;
+
+    for (uint32_t i = 0; i < header->key_count; ++i) {
+        const Registry_Snapshot_Key* key = &snapshot->keys[i];
+        if (!reg__snapshot_string_is_valid(snapshot, key->path_offset, key->path_len)) return false;
+        if ((uint64_t) key->first_value + key->value_count > header->value_count) return false;
+    }
+    for (uint32_t i = 0; i < header->value_count; ++i) {
+        const Registry_Snapshot_Value* value = &snapshot->values[i];
+        if (!reg__snapshot_string_is_valid(snapshot, value->name_offset, value->name_len)) return false;
+        if (!reg__snapshot_string_is_valid(snapshot, value->data_offset, value->data_len)) return false;
+        if (value->type > REG_TYPE_DELETE) return false;
+    }
+    return true;
+}
+
+void reg_snapshot_unload(Registry_Snapshot* snapshot) {
+    if (snapshot->base != NULL) unmap_file(sv_from_parts(snapshot->base, snapshot->size));
+    memset(snapshot, 0, sizeof(*snapshot));
+}
+
+// Add the values of the key at index in a snapshot to key->list, and set its last write time
+static void reg__snapshot_key_values(const Registry_Snapshot* snapshot, uint32_t index, Registry_Key* key) {
+    const Registry_Snapshot_Key* snapshot_key = &snapshot->keys[index];
+    key->last_write_time = snapshot_key->last_write_time;
+    for (uint32_t j = 0; j < snapshot_key->value_count; ++j) {
+        const Registry_Snapshot_Value* value = &snapshot->values[snapshot_key->first_value + j];
+        Registry_Value item = {
+            .name = (char*) snapshot->strings + value->name_offset,
+            .name_len = value->name_len,
+            .type = value->type,
+            .type_hex_type = value->type_hex_type,
+            .data = (char*) snapshot->strings + value->data_offset,
+            .data_len = value->data_len,
+        };
+        da_append(&key->list, item);
+    }
+}
+
+bool reg_snapshot_get_key(const Registry_Snapshot* snapshot, Registry_Key* key) {
+    size_t path_len = strlen(key->path);
+    for (uint32_t i = 0; i < snapshot->header->key_count; ++i) {
+        const Registry_Snapshot_Key* snapshot_key = &snapshot->keys[i];
+        if (snapshot_key->path_len != path_len || memcmp(snapshot->strings + snapshot_key->path_offset, key->path, path_len) != 0) continue;
+
+        reg__snapshot_key_values(snapshot, i, key);
+        return true;
+    }
+    return false;
+}
+
+// State of the .reg file parser
+// Every path, name and data is written to the pool, which is as big as the file. Nothing in a .reg file
+// decodes to more bytes than it takes up in the file, including the NUL that follows every string.
+typedef struct {
+    const char* path;
+    const char* cursor;
+    const char* end;
+    size_t line;
+    char* pool;
+    size_t pool_count;
+} Reg__Parser;
+
+static bool reg__parser_error(const Reg__Parser* parser, const char* message) {
+    nob_log(NOB_ERROR, "%s:%zu: %s", parser->path, parser->line, message);
+    return false;
+}
+
+static bool reg__parser_at_line_end(const Reg__Parser* parser) {
+    return parser->cursor >= parser->end || *parser->cursor == '\r' || *parser->cursor == '\n';
+}
+
+static void reg__parser_skip_blank(Reg__Parser* parser) {
+    while (parser->cursor < parser->end && (*parser->cursor == ' ' || *parser->cursor == '\t')) ++parser->cursor;
+}
+
+static void reg__parser_skip_line(Reg__Parser* parser) {
+    while (parser->cursor < parser->end && *parser->cursor != '\n') ++parser->cursor;
+}
+
+static bool reg__parser_starts_with(const Reg__Parser* parser, const char* prefix) {
+    size_t len = strlen(prefix);
+    return (size_t) (parser->end - parser->cursor) >= len && memcmp(parser->cursor, prefix, len) == 0;
+}
+
+// Value of every hex digit plus one, or zero for characters that aren't hex digits
+static const unsigned char reg__hex_digits[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+};
+
+// Returns the value of a hex digit, or -1 if it isn't one
+static int reg__hex_digit(char chr) {
+    return (int) reg__hex_digits[(unsigned char) chr] - 1;
+}
+
+// Parse a quoted and escaped string into the pool
+// Returns true on success, false on failure
+static bool reg__parse_string(Reg__Parser* parser, char** result, size_t* result_len) {
+    char* out = parser->pool + parser->pool_count;
+    size_t len = 0;
+    // Skip the opening quote
+    ++parser->cursor;
+    while (true) {
+        // Copy everything up to the next special character in one go
+        const char* cursor = parser->cursor;
+        while (cursor < parser->end && *cursor != '"' && *cursor != '\\' && *cursor != '\n' && *cursor != '\r') ++cursor;
+        memcpy(out + len, parser->cursor, cursor - parser->cursor);
+        len += cursor - parser->cursor;
+        parser->cursor = cursor;
+
+        if (reg__parser_at_line_end(parser)) return reg__parser_error(parser, "Unterminated string");
+        char chr = *parser->cursor++;
+        if (chr == '"') break;
+        if (chr == '\\' && parser->cursor < parser->end) {
+            char escaped = *parser->cursor++;
+            switch (escaped) {
+            case '\\': out[len++] = '\\'; break;
+            case '"':  out[len++] = '"';  break;
+            case 'n':  out[len++] = '\n'; break;
+            default:
+                // Keep unknown escapes as they are
+                out[len++] = '\\';
+                out[len++] = escaped;
+                break;
+            }
+            continue;
+        }
+        out[len++] = chr;
+    }
+    out[len] = 0;
+    parser->pool_count += len + 1;
+    *result = out;
+    *result_len = len;
+    return true;
+}
+
+// Parse a list of comma separated hex bytes into the pool, including lines continued with a `\`
+// Returns true on success, false on failure
+static bool reg__parse_hex(Reg__Parser* parser, Registry_Value* value) {
+    char* out = parser->pool + parser->pool_count;
+    size_t len = 0;
+    while (true) {
+        // Fast path for the `xx,` that makes up almost all of the bytes
+        while (parser->end - parser->cursor >= 3 && parser->cursor[2] == ',') {
+            int high = reg__hex_digit(parser->cursor[0]);
+            int low = reg__hex_digit(parser->cursor[1]);
+            if ((high | low) < 0) break;
+            out[len++] = (char) (high << 4 | low);
+            parser->cursor += 3;
+        }
+
+        reg__parser_skip_blank(parser);
+        if (parser->cursor < parser->end && *parser->cursor == '\\') {
+            // The bytes continue on the next line
+            ++parser->cursor;
+            reg__parser_skip_blank(parser);
+            if (parser->cursor < parser->end && *parser->cursor == '\r') ++parser->cursor;
+            if (parser->cursor >= parser->end || *parser->cursor != '\n') return reg__parser_error(parser, "Expected a new line after `\\`");
+            ++parser->cursor;
+            ++parser->line;
+            continue;
+        }
+        if (reg__parser_at_line_end(parser)) break;
+
+        int high = reg__hex_digit(*parser->cursor);
+        if (high < 0) return reg__parser_error(parser, "Invalid hex byte");
+        ++parser->cursor;
+        int low = parser->cursor < parser->end ? reg__hex_digit(*parser->cursor) : -1;
+        if (low >= 0) {
+            ++parser->cursor;
+            out[len++] = (char) (high << 4 | low);
+        } else {
+            out[len++] = (char) high;
+        }
+        reg__parser_skip_blank(parser);
+        if (parser->cursor < parser->end && *parser->cursor == ',') ++parser->cursor;
+    }
+    out[len] = 0;
+    parser->pool_count += len + 1;
+    value->data = out;
+    value->data_len = len;
+    return true;
+}
+
+// Parse a value line, adding the value to key
+// Returns true on success, false on failure
+static bool reg__parse_value(Reg__Parser* parser, Registry_Key* key) {
+    Registry_Value value = {0};
+    if (*parser->cursor == '@') {
+        // The default value of the key has an empty name
+        ++parser->cursor;
+        value.name = parser->pool + parser->pool_count;
+        parser->pool[parser->pool_count++] = 0;
+    } else if (!reg__parse_string(parser, &value.name, &value.name_len)) {
+        return false;
+    }
+
+    reg__parser_skip_blank(parser);
+    if (parser->cursor >= parser->end || *parser->cursor != '=') return reg__parser_error(parser, "Expected `=` after the value name");
+    ++parser->cursor;
+    reg__parser_skip_blank(parser);
+
+    if (parser->cursor < parser->end && *parser->cursor == '"') {
+        value.type = REG_TYPE_STRING;
+        if (!reg__parse_string(parser, &value.data, &value.data_len)) return false;
+        // Like RegEnumValueA, the length of a string includes its NUL
+        value.data_len += 1;
+    } else if (parser->cursor < parser->end && *parser->cursor == '-') {
+        ++parser->cursor;
+        value.type = REG_TYPE_DELETE;
+    } else if (reg__parser_starts_with(parser, "dword:")) {
+        parser->cursor += strlen("dword:");
+        uint32_t dword = 0;
+        size_t digits = 0;
+        for (; parser->cursor < parser->end && reg__hex_digit(*parser->cursor) >= 0 && digits < 8; ++parser->cursor, ++digits) {
+            dword = dword << 4 | (uint32_t) reg__hex_digit(*parser->cursor);
+        }
+        if (digits == 0) return reg__parser_error(parser, "Invalid dword");
+        // REG_DWORD is stored little-endian
+        value.type = REG_TYPE_HEX;
+        value.type_hex_type = 4;
+        value.data = parser->pool + parser->pool_count;
+        for (size_t i = 0; i < 4; ++i) value.data[i] = (char) (dword >> (i * 8));
+        value.data[4] = 0;
+        value.data_len = 4;
+        parser->pool_count += 5;
+    } else if (reg__parser_starts_with(parser, "hex")) {
+        parser->cursor += strlen("hex");
+        value.type = REG_TYPE_HEX;
+        // hex: is REG_BINARY, other types are written as hex(type):
+        value.type_hex_type = 3;
+        if (parser->cursor < parser->end && *parser->cursor == '(') {
+            ++parser->cursor;
+            value.type_hex_type = 0;
+            for (; parser->cursor < parser->end && reg__hex_digit(*parser->cursor) >= 0; ++parser->cursor) {
+                value.type_hex_type = value.type_hex_type << 4 | (uint32_t) reg__hex_digit(*parser->cursor);
+            }
+            if (parser->cursor >= parser->end || *parser->cursor != ')') return reg__parser_error(parser, "Invalid hex type");
+            ++parser->cursor;
+        }
+        if (parser->cursor >= parser->end || *parser->cursor != ':') return reg__parser_error(parser, "Expected `:` after hex");
+        ++parser->cursor;
+        if (!reg__parse_hex(parser, &value)) return false;
+    } else {
+        return reg__parser_error(parser, "Invalid value data");
+    }
+
+    reg__parser_skip_blank(parser);
+    if (!reg__parser_at_line_end(parser)) return reg__parser_error(parser, "Unexpected text after the value");
+    da_append(&key->list, value);
+    return true;
+}
+
+// Parse a key line, adding the key to the file
+// Sets *key to the new key, or NULL if the values that follow should be skipped
+// Returns true on success, false on failure
+static bool reg__parse_key(Reg__Parser* parser, Registry_File* file, Registry_Key** key) {
+    static const char root[] = "HKEY_LOCAL_MACHINE\\";
+    const size_t root_len = sizeof(root) - 1;
+
+    // Skip the opening bracket
+    ++parser->cursor;
+    bool deleted = false;
+    if (parser->cursor < parser->end && *parser->cursor == '-') {
+        deleted = true;
+        ++parser->cursor;
+    }
+    // Key names may contain brackets themselves, so the path ends at the last bracket of the line
+    const char* start = parser->cursor;
+    const char* close = NULL;
+    for (; !reg__parser_at_line_end(parser); ++parser->cursor) {
+        if (*parser->cursor == ']') close = parser->cursor;
+    }
+    if (close == NULL) return reg__parser_error(parser, "Unterminated key");
+
+    size_t len = close - start;
+    if (len <= root_len || reg_name_compare(start, root_len, root, root_len) != 0) {
+        nob_log(NOB_WARNING, "%s:%zu: Skipping key %.*s outside of HKEY_LOCAL_MACHINE", parser->path, parser->line, (int) len, start);
+        *key = NULL;
+        return true;
+    }
+
+    char* path = parser->pool + parser->pool_count;
+    memcpy(path, start + root_len, len - root_len);
+    path[len - root_len] = 0;
+    parser->pool_count += len - root_len + 1;
+
+    Registry_Key new_key = {.path = path, .deleted = deleted};
+    da_append(&file->keys, new_key);
+    // Values below a deleted key are meaningless
+    *key = deleted ? NULL : &file->keys.items[file->keys.count - 1];
+    return true;
+}
+
+void reg_utf16le_to_utf8(const void* utf16, size_t size, String_Builder* sb) {
+    const unsigned char* data = utf16;
+    for (size_t i = 0; i + 1 < size; i += 2) {
+        uint32_t codepoint = data[i] | (uint32_t) data[i + 1] << 8;
+        if (codepoint >= 0xD800 && codepoint < 0xDC00 && i + 3 < size) {
+            uint32_t low = data[i + 2] | (uint32_t) data[i + 3] << 8;
+            if (low >= 0xDC00 && low < 0xE000) {
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                i += 2;
+            }
+        }
+        if (codepoint < 0x80) {
+            da_append(sb, (char) codepoint);
+        } else if (codepoint < 0x800) {
+            da_append(sb, (char) (0xC0 | codepoint >> 6));
+            da_append(sb, (char) (0x80 | (codepoint & 0x3F)));
+        } else if (codepoint < 0x10000) {
+            da_append(sb, (char) (0xE0 | codepoint >> 12));
+            da_append(sb, (char) (0x80 | (codepoint >> 6 & 0x3F)));
+            da_append(sb, (char) (0x80 | (codepoint & 0x3F)));
+        } else {
+            da_append(sb, (char) (0xF0 | codepoint >> 18));
+            da_append(sb, (char) (0x80 | (codepoint >> 12 & 0x3F)));
+            da_append(sb, (char) (0x80 | (codepoint >> 6 & 0x3F)));
+            da_append(sb, (char) (0x80 | (codepoint & 0x3F)));
+        }
+    }
+}
+
+// A key that is being sorted, along with its original position to keep the sort stable
+typedef struct {
+    Registry_Key* key;
+    size_t index;
+} Reg__Key_Sort_Item;
+
+static int reg__key_path_compare(const Registry_Key* a, const Registry_Key* b) {
+    return reg_name_compare(a->path, strlen(a->path), b->path, strlen(b->path));
+}
+
+static int reg__key_sort_item_compare(const void* a, const void* b) {
+    const Reg__Key_Sort_Item* item_a = a;
+    const Reg__Key_Sort_Item* item_b = b;
+    int result = reg__key_path_compare(item_a->key, item_b->key);
+    if (result != 0) return result;
+    return (item_a->index > item_b->index) - (item_a->index < item_b->index);
+}
+
+// Sort the keys of a file by path, merging keys with the same path in the order they appeared
+static void reg__file_sort_keys(Registry_File* file) {
+    if (file->keys.count == 0) return;
+    Reg__Key_Sort_Item* items = NOB_REALLOC(NULL, sizeof(*items) * file->keys.count);
+    NOB_ASSERT(items != NULL && "Buy more RAM lol");
+    for (size_t i = 0; i < file->keys.count; ++i) {
+        items[i] = (Reg__Key_Sort_Item) {.key = &file->keys.items[i], .index = i};
+    }
+    qsort(items, file->keys.count, sizeof(*items), reg__key_sort_item_compare);
+
+    Registry_Key_List sorted = {0};
+    for (size_t i = 0; i < file->keys.count; ++i) {
+        Registry_Key* key = items[i].key;
+        if (sorted.count == 0 || reg__key_path_compare(&sorted.items[sorted.count - 1], key) != 0) {
+            da_append(&sorted, *key);
+            continue;
+        }
+        Registry_Key* merged = &sorted.items[sorted.count - 1];
+        if (key->deleted) {
+            // Deleting the key throws away everything that was added before
+            merged->list.count = 0;
+            merged->deleted = true;
+        } else {
+            merged->deleted = false;
+            da_append_many(&merged->list, key->list.items, key->list.count);
+        }
+        da_free(key->list);
+    }
+
+    NOB_FREE(items);
+    da_free(file->keys);
+    file->keys = sorted;
+}
+
+static bool reg__parse(const char* path, const char* content, size_t size, Registry_File* file) {
+    file->pool = NOB_REALLOC(NULL, size + 1);
+    NOB_ASSERT(file->pool != NULL && "Buy more RAM lol");
+    Reg__Parser parser = {
+        .path = path,
+        .cursor = content,
+        .end = content + size,
+        .line = 1,
+        .pool = file->pool,
+    };
+
+    bool has_header = false;
+    bool has_key = false;
+    Registry_Key* key = NULL;
+    while (parser.cursor < parser.end) {
+        char chr = *parser.cursor;
+        if (chr == '\n') {
+            ++parser.cursor;
+            ++parser.line;
+        } else if (chr == '\r' || chr == ' ' || chr == '\t') {
+            ++parser.cursor;
+        } else if (chr == ';') {
+            reg__parser_skip_line(&parser);
+        } else if (!has_header) {
+            if (!reg__parser_starts_with(&parser, "Windows Registry Editor Version") && !reg__parser_starts_with(&parser, "REGEDIT4")) {
+                return reg__parser_error(&parser, "Missing .reg header");
+            }
+            has_header = true;
+            reg__parser_skip_line(&parser);
+        } else if (chr == '[') {
+            if (!reg__parse_key(&parser, file, &key)) return false;
+            has_key = true;
+        } else if (chr == '"' || chr == '@') {
+            if (!has_key) return reg__parser_error(&parser, "Value outside of a key");
+            if (key == NULL) {
+                reg__parser_skip_line(&parser);
+            } else if (!reg__parse_value(&parser, key)) {
+                return false;
+            }
+        } else {
+            return reg__parser_error(&parser, "Unexpected line");
+        }
+    }
+    if (!has_header) return reg__parser_error(&parser, "Missing .reg header");
+
+    reg__file_sort_keys(file);
+    return true;
+}
+
+// Parse a .reg file, handling its byte order mark
+static bool reg__file_parse(const char* path, const char* content, size_t size, Registry_File* file) {
+    const unsigned char* bytes = (const unsigned char*) content;
+    if (size >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE) {
+        // regedit exports UTF-16LE
+        String_Builder utf8 = {0};
+        reg_utf16le_to_utf8(bytes + 2, size - 2, &utf8);
+        bool result = reg__parse(path, utf8.items, utf8.count, file);
+        sb_free(utf8);
+        return result;
+    }
+    if (size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) {
+        return reg__parse(path, content + 3, size - 3, file);
+    }
+    return reg__parse(path, content, size, file);
+}
+
+bool reg_file_parse(const char* path, const char* content, size_t size, Registry_File* file) {
+    memset(file, 0, sizeof(*file));
+    bool result = reg__file_parse(path, content, size, file);
+    if (!result) reg_file_free(file);
+    return result;
+}
+
+// Take the keys of the snapshot of which file->snapshot.base and size are set
+static bool reg__file_read_snapshot(const char* path, Registry_File* file) {
+    if (!reg__snapshot_open(path, &file->snapshot)) return false;
+    if (!reg_snapshot_verify(&file->snapshot)) {
+        nob_log(NOB_ERROR, "Snapshot %s is corrupted", path);
+        return false;
+    }
+    for (uint32_t i = 0; i < file->snapshot.header->key_count; ++i) {
+        Registry_Key key = {.path = file->snapshot.strings + file->snapshot.keys[i].path_offset};
+        reg__snapshot_key_values(&file->snapshot, i, &key);
+        da_append(&file->keys, key);
+    }
+    reg__file_sort_keys(file);
+    return true;
+}
+
+static bool reg__is_snapshot(const void* content, size_t size) {
+    return size >= sizeof(REG_SNAPSHOT_MAGIC) - 1 && memcmp(content, REG_SNAPSHOT_MAGIC, sizeof(REG_SNAPSHOT_MAGIC) - 1) == 0;
+}
+
+bool reg_file_read(const char* path, Registry_File* file) {
+    memset(file, 0, sizeof(*file));
+    // Every kind of file is read from the start to the end, except for snapshots that are used in place
+    String_View view;
+    if (!map_file(path, &view, MAP_SEQUENTIAL)) return false;
+
+    bool result;
+    if (reg_lz_is_compressed(view.data, view.count)) {
+        String_Builder content = {0};
+        result = reg_lz_decompress(path, view.data, view.count, &content);
+        unmap_file(view);
+        if (!result) {
+            sb_free(content);
+            return false;
+        }
+        if (reg__is_snapshot(content.items, content.count)) {
+            // The snapshot is used in place, so the file keeps the decompressed contents
+            file->buffer = content.items;
+            file->snapshot.base = content.items;
+            file->snapshot.size = content.count;
+            result = reg__file_read_snapshot(path, file);
+        } else {
+            result = reg__file_parse(path, content.items, content.count, file);
+            sb_free(content);
+        }
+    } else if (reg__is_snapshot(view.data, view.count)) {
+        // The snapshot is used in place, so it stays mapped
+        file->snapshot.base = view.data;
+        file->snapshot.size = view.count;
+        result = reg__file_read_snapshot(path, file);
+    } else {
+        // Everything is copied into the pool, so the file doesn't need to stay mapped
+        result = reg__file_parse(path, view.data, view.count, file);
+        unmap_file(view);
+    }
+    if (!result) reg_file_free(file);
+    return result;
+}
+
+Registry_Key* reg_file_find_key(const Registry_File* file, const char* path) {
+    Registry_Key needle = {.path = path};
+    size_t low = 0;
+    size_t high = file->keys.count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        int result = reg__key_path_compare(&file->keys.items[middle], &needle);
+        if (result == 0) return &file->keys.items[middle];
+        if (result < 0) low = middle + 1;
+        else high = middle;
+    }
+    return NULL;
+}
+
+void reg_file_free(Registry_File* file) {
+    for (size_t i = 0; i < file->keys.count; ++i) da_free(file->keys.items[i].list);
+    da_free(file->keys);
+    NOB_FREE(file->pool);
+    if (file->buffer != NULL) {
+        NOB_FREE(file->buffer);
+    } else {
+        reg_snapshot_unload(&file->snapshot);
+    }
+    memset(file, 0, sizeof(*file));
+}
+
+// Round a size in the journal up to the alignment of the snapshot header
+static size_t reg__journal_align(size_t size) {
+    return (size + 7) & ~(size_t) 7;
+}
+
+bool reg_journal_write(const char* path, const Registry_Key* undo, const Registry_Key* redo, size_t key_count) {
+    bool result = true;
+    String_Builder sb = {0};
+    String_Builder snapshot = {0};
+    FILE* f = NULL;
+
+    Registry_Journal_Header header = {.version = REG_JOURNAL_VERSION};
+    memcpy(header.magic, REG_JOURNAL_MAGIC, sizeof(header.magic));
+    sb_append_buf(&sb, &header, sizeof(header));
+
+    reg_snapshot_serialize(undo, key_count, &snapshot);
+    sb_append_buf(&sb, snapshot.items, snapshot.count);
+    ((Registry_Journal_Header*) sb.items)->undo_size = snapshot.count;
+    while (sb.count < reg__journal_align(sb.count)) da_append(&sb, 0);
+
+    reg_snapshot_serialize(redo, key_count, &snapshot);
+    sb_append_buf(&sb, snapshot.items, snapshot.count);
+    ((Registry_Journal_Header*) sb.items)->redo_size = snapshot.count;
+
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        nob_log(NOB_ERROR, "Could not open file %s: %s", path, strerror(errno));
+        return_defer(false);
+    }
+    fwrite(sb.items, 1, sb.count, f);
+    if (ferror(f) || fflush(f) != 0) {
+        nob_log(NOB_ERROR, "Could not write file %s: %s", path, strerror(errno));
+        return_defer(false);
+    }
+    // The journal needs to be on the disk before anything is changed, not only in the cache of the OS
+#ifdef _WIN32
+    int code = _commit(fileno(f));
+#else
+    int code = fsync(fileno(f));
+#endif // _WIN32
+    if (code != 0) {
+        nob_log(NOB_ERROR, "Could not flush file %s: %s", path, strerror(errno));
+        return_defer(false);
+    }
+
+defer:
+    if (f != NULL) fclose(f);
+    sb_free(snapshot);
+    sb_free(sb);
+    return result;
+}
+
+// Set up a snapshot of the journal, and check it if it fits in the journal
+// Returns true if the snapshot is intact, false otherwise
+static bool reg__journal_snapshot(const char* path, Registry_Journal* journal, size_t offset, uint64_t size, Registry_Snapshot* snapshot) {
+    if (offset > journal->content.count || size > journal->content.count - offset) return false;
+    snapshot->base = journal->content.items + offset;
+    snapshot->size = (size_t) size;
+    return reg__snapshot_open(path, snapshot) && reg_snapshot_verify(snapshot);
+}
+
+bool reg_journal_read(const char* path, Registry_Journal* journal) {
+    memset(journal, 0, sizeof(*journal));
+    if (!read_entire_file(path, &journal->content)) return false;
+
+    const Registry_Journal_Header* header = (const Registry_Journal_Header*) journal->content.items;
+    if (journal->content.count < sizeof(*header) || memcmp(header->magic, REG_JOURNAL_MAGIC, sizeof(header->magic)) != 0) return true;
+    if (header->version != REG_JOURNAL_VERSION) {
+        nob_log(NOB_ERROR, "Unsupported journal version %u in %s", header->version, path);
+        reg_journal_free(journal);
+        return false;
+    }
+    size_t undo_offset = sizeof(*header);
+    if (header->undo_size > journal->content.count) return true;
+    size_t redo_offset = reg__journal_align(undo_offset + (size_t) header->undo_size);
+    journal->complete = reg__journal_snapshot(path, journal, undo_offset, header->undo_size, &journal->undo)
+                     && reg__journal_snapshot(path, journal, redo_offset, header->redo_size, &journal->redo)
+                     && redo_offset + header->redo_size == journal->content.count;
+    return true;
+}
+
+void reg_journal_free(Registry_Journal* journal) {
+    // The snapshots don't own their memory
+    sb_free(journal->content);
+    memset(journal, 0, sizeof(*journal));
+}
+
+// Key cell of a hive
+typedef struct {
+    char magic[2];
+    uint16_t flags;
+    uint32_t last_write_time_low;
+    uint32_t last_write_time_high;
+    uint32_t access_bits;
+    uint32_t parent;
+    uint32_t subkey_count;
+    uint32_t volatile_subkey_count;
+    uint32_t subkey_list;
+    uint32_t volatile_subkey_list;
+    uint32_t value_count;
+    uint32_t value_list;
+    uint32_t security;
+    uint32_t class_name;
+    uint32_t max_subkey_name_len;
+    uint32_t max_subkey_class_len;
+    uint32_t max_value_name_len;
+    uint32_t max_value_data_len;
+    uint32_t work_var;
+    uint16_t name_len;
+    uint16_t class_name_len;
+    // Followed by the name
+} Reg__Hive_Key;
+
+// Value cell of a hive
+typedef struct {
+    char magic[2];
+    uint16_t name_len;
+    // The data is stored in data itself if REG__HIVE_DATA_INLINE is set
+    uint32_t data_size;
+    uint32_t data;
+    uint32_t type;
+    uint16_t flags;
+    uint16_t spare;
+    // Followed by the name
+} Reg__Hive_Value;
+
+// Cell that splits big data into segments
+typedef struct {
+    char magic[2];
+    uint16_t segment_count;
+    uint32_t segment_list;
+} Reg__Hive_Big_Data;
+
+// The name of the key is Latin-1 instead of UTF-16LE
+#define REG__HIVE_KEY_COMP_NAME 0x0020
+// The name of the value is Latin-1 instead of UTF-16LE
+#define REG__HIVE_VALUE_COMP_NAME 0x0001
+#define REG__HIVE_DATA_INLINE 0x80000000u
+// Data bigger than this is split over a db cell, since hive version 1.4
+#define REG__HIVE_MAX_SEGMENT 16344
+// Maximum depth of ri lists, which only ever point to other lists
+#define REG__HIVE_MAX_LIST_DEPTH 2
+// Hive bins that are added to a hive have room for at least this many bytes, so the file is grown rarely
+#define REG__HIVE_GROW_SIZE (16 * REG_HIVE_BLOCK_SIZE)
+
+// Header of a hive bin
+typedef struct {
+    char magic[4];
+    // Offset of the hive bin itself
+    uint32_t offset;
+    uint32_t size;
+    uint32_t reserved[2];
+    uint32_t timestamp_low;
+    uint32_t timestamp_high;
+    uint32_t spare;
+} Reg__Hive_Bin;
+
+// Compute the checksum of a base block
+static uint32_t reg__hive_checksum(const Registry_Hive_Header* header) {
+    uint32_t checksum = 0;
+    for (size_t i = 0; i < offsetof(Registry_Hive_Header, checksum) / sizeof(uint32_t); ++i) {
+        uint32_t word;
+        memcpy(&word, (const uint8_t*) header + i * sizeof(word), sizeof(word));
+        checksum ^= word;
+    }
+    // 0 and 0xFFFFFFFF are never used as checksums
+    if (checksum == 0xFFFFFFFFu) checksum = 0xFFFFFFFEu;
+    if (checksum == 0) checksum = 1;
+    return checksum;
+}
+
+// Get the data of an allocated cell, if it is inside of the hive bins and holds at least size bytes
+// Returns the data, or NULL if the cell is invalid
+static uint8_t* reg__hive_cell(const Registry_Hive* hive, uint32_t offset, size_t size, size_t* cell_size) {
+    uint32_t bins_size = hive->header->bins_size;
+    if (offset % 8 != 0 || offset >= bins_size || bins_size - offset < sizeof(int32_t)) return NULL;
+    uint8_t* cell = hive->bins + offset;
+    int32_t signed_size;
+    memcpy(&signed_size, cell, sizeof(signed_size));
+    // Free cells have a positive size
+    if (signed_size >= 0) return NULL;
+    uint32_t total_size = (uint32_t) -(int64_t) signed_size;
+    if (total_size < sizeof(int32_t) + size || total_size > bins_size - offset) return NULL;
+    if (cell_size != NULL) *cell_size = total_size - sizeof(int32_t);
+    return cell + sizeof(int32_t);
+}
+
+// Get a key cell
+// Returns the key, or NULL if the cell is not a valid key
+static const Reg__Hive_Key* reg__hive_key(const Registry_Hive* hive, uint32_t offset) {
+    size_t cell_size = 0;
+    const Reg__Hive_Key* key = (const Reg__Hive_Key*) reg__hive_cell(hive, offset, sizeof(Reg__Hive_Key), &cell_size);
+    if (key == NULL || memcmp(key->magic, "nk", 2) != 0 || sizeof(*key) + key->name_len > cell_size) return NULL;
+    return key;
+}
+
+// Get a value cell
+// Returns the value, or NULL if the cell is not a valid value
+static Reg__Hive_Value* reg__hive_value(const Registry_Hive* hive, uint32_t offset) {
+    size_t cell_size = 0;
+    Reg__Hive_Value* value = (Reg__Hive_Value*) reg__hive_cell(hive, offset, sizeof(Reg__Hive_Value), &cell_size);
+    if (value == NULL || memcmp(value->magic, "vk", 2) != 0 || sizeof(*value) + value->name_len > cell_size) return NULL;
+    return value;
+}
+
+// Add a name of a key or value to a string builder as UTF-8
+static void reg__hive_append_name(const uint8_t* name, size_t name_len, bool latin1, String_Builder* sb) {
+    if (!latin1) {
+        reg_utf16le_to_utf8(name, name_len, sb);
+        return;
+    }
+    for (size_t i = 0; i < name_len; ++i) {
+        if (name[i] < 0x80) {
+            da_append(sb, (char) name[i]);
+        } else {
+            da_append(sb, (char) (0xC0 | name[i] >> 6));
+            da_append(sb, (char) (0x80 | (name[i] & 0x3F)));
+        }
+    }
+}
+
+// Check whether a name of a key or value is the same as name, case insensitive
+static bool reg__hive_name_eq(const uint8_t* stored, size_t stored_len, bool latin1, const char* name, size_t name_len, String_Builder* scratch) {
+    if (latin1 && stored_len == name_len) {
+        // Most names are ASCII, which can be compared without converting them
+        bool ascii = true;
+        for (size_t i = 0; i < name_len && ascii; ++i) ascii = stored[i] < 0x80;
+        if (ascii) return reg_name_compare((const char*) stored, name_len, name, name_len) == 0;
+    }
+    scratch->count = 0;
+    reg__hive_append_name(stored, stored_len, latin1, scratch);
+    return reg_name_compare(scratch->items, scratch->count, name, name_len) == 0;
+}
+
+static bool reg__hive_key_name_eq(const Reg__Hive_Key* key, const char* name, size_t name_len, String_Builder* scratch) {
+    return reg__hive_name_eq((const uint8_t*) (key + 1), key->name_len, key->flags & REG__HIVE_KEY_COMP_NAME, name, name_len, scratch);
+}
+
+// Search a subkey list for a key with a name
+// Returns true if the key was found, and sets result to the offset of its cell, false otherwise
+static bool reg__hive_find_subkey(const Registry_Hive* hive, uint32_t list_offset, const char* name, size_t name_len, int depth, String_Builder* scratch, uint32_t* result) {
+    size_t cell_size = 0;
+    const uint8_t* list = reg__hive_cell(hive, list_offset, 4, &cell_size);
+    if (list == NULL) return false;
+    uint16_t count;
+    memcpy(&count, list + 2, sizeof(count));
+    // lf and lh lists have a hint or hash after every offset, li and ri lists only have offsets
+    bool hinted = memcmp(list, "lf", 2) == 0 || memcmp(list, "lh", 2) == 0;
+    bool indirect = memcmp(list, "ri", 2) == 0;
+    if (!hinted && !indirect && memcmp(list, "li", 2) != 0) return false;
+    size_t stride = hinted ? 8 : 4;
+    if (4 + (size_t) count * stride > cell_size) return false;
+    if (indirect && depth >= REG__HIVE_MAX_LIST_DEPTH) return false;
+
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t offset;
+        memcpy(&offset, list + 4 + i * stride, sizeof(offset));
+        if (indirect) {
+            if (reg__hive_find_subkey(hive, offset, name, name_len, depth + 1, scratch, result)) return true;
+            continue;
+        }
+        const Reg__Hive_Key* key = reg__hive_key(hive, offset);
+        if (key != NULL && reg__hive_key_name_eq(key, name, name_len, scratch)) {
+            *result = offset;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Map a hive for reading, or for reading and writing, and check its base block
+// Returns true on success, false on failure
+static bool reg__hive_open(const char* path, Registry_Hive* hive, bool writable) {
+    memset(hive, 0, sizeof(*hive));
+    hive->last_bin = REG_HIVE_NO_CELL;
+    if (writable) {
+        hive->file = reg__open_file_shared(path);
+        if (hive->file == NOB_INVALID_FD) return false;
+        hive->path = path;
+        if (!reg__map_file_shared(path, hive->file, 0, &hive->base, &hive->size)) goto fail;
+    } else {
+        // Only the cells on the way to the keys are read, which are all over the hive
+        String_View view;
+        if (!map_file(path, &view, MAP_RANDOM)) return false;
+        // A hive that is opened for reading is never written to
+        hive->base = (void*) view.data;
+        hive->size = view.count;
+    }
+
+    Registry_Hive_Header* header = hive->base;
+    if (hive->size < sizeof(*header) || memcmp(header->magic, REG_HIVE_MAGIC, sizeof(header->magic)) != 0) {
+        nob_log(NOB_ERROR, "%s is not a registry hive", path);
+        goto fail;
+    }
+    if (header->major_version != 1 || header->file_type != 0) {
+        nob_log(NOB_ERROR, "Unsupported hive version %u.%u or type %u in %s", header->major_version, header->minor_version, header->file_type, path);
+        goto fail;
+    }
+    if (reg__hive_checksum(header) != header->checksum) {
+        nob_log(NOB_ERROR, "The base block of hive %s is corrupted", path);
+        goto fail;
+    }
+    if (header->bins_size % REG_HIVE_BLOCK_SIZE != 0 || header->bins_size > hive->size - sizeof(*header)) {
+        nob_log(NOB_ERROR, "Hive %s is truncated", path);
+        goto fail;
+    }
+    if (header->primary_sequence != header->secondary_sequence) {
+        nob_log(writable ? NOB_ERROR : NOB_WARNING, "Hive %s wasn't written back completely, the changes in its transaction logs are missing", path);
+        // Writing to it would make the missing changes impossible to recover
+        if (writable) goto fail;
+    }
+
+    hive->header = header;
+    hive->bins = (uint8_t*) hive->base + sizeof(*header);
+    if (memcmp(hive->bins, REG_HIVE_BIN_MAGIC, 4) != 0 || reg__hive_key(hive, header->root) == NULL) {
+        nob_log(NOB_ERROR, "The root key of hive %s is corrupted", path);
+        goto fail;
+    }
+    return true;
+
+fail:
+    reg_hive_close(hive);
+    return false;
+}
+
+bool reg_hive_open(const char* path, Registry_Hive* hive) {
+    return reg__hive_open(path, hive, false);
+}
+
+bool reg_hive_find_key(const Registry_Hive* hive, const char* path, uint32_t* key) {
+    bool result = true;
+    String_Builder scratch = {0};
+    uint32_t offset = hive->header->root;
+    while (*path != '\0') {
+        const char* separator = strchr(path, '\\');
+        size_t name_len = separator != NULL ? (size_t) (separator - path) : strlen(path);
+        if (name_len > 0) {
+            const Reg__Hive_Key* parent = reg__hive_key(hive, offset);
+            if (parent == NULL || parent->subkey_count == 0) return_defer(false);
+            if (!reg__hive_find_subkey(hive, parent->subkey_list, path, name_len, 0, &scratch, &offset)) return_defer(false);
+        }
+        path += name_len;
+        if (*path == '\\') ++path;
+    }
+    *key = offset;
+
+defer:
+    sb_free(scratch);
+    return result;
+}
+
+// Add the data of a value to a string builder
+// Returns true on success, false if the data is corrupted
+static bool reg__hive_value_data(const Registry_Hive* hive, const Reg__Hive_Value* value, String_Builder* sb) {
+    uint32_t size = value->data_size & ~REG__HIVE_DATA_INLINE;
+    if (value->data_size & REG__HIVE_DATA_INLINE) {
+        if (size > sizeof(value->data)) return false;
+        sb_append_buf(sb, &value->data, size);
+        return true;
+    }
+    if (size == 0) return true;
+    if (size > REG__HIVE_MAX_SEGMENT && hive->header->minor_version >= 4) {
+        const Reg__Hive_Big_Data* big = (const Reg__Hive_Big_Data*) reg__hive_cell(hive, value->data, sizeof(Reg__Hive_Big_Data), NULL);
+        if (big == NULL || memcmp(big->magic, "db", 2) != 0) return false;
+        const uint8_t* segments = reg__hive_cell(hive, big->segment_list, (size_t) big->segment_count * sizeof(uint32_t), NULL);
+        if (segments == NULL) return false;
+        for (uint16_t i = 0; i < big->segment_count && size > 0; ++i) {
+            uint32_t segment_offset;
+            memcpy(&segment_offset, segments + i * sizeof(uint32_t), sizeof(segment_offset));
+            uint32_t segment_size = size < REG__HIVE_MAX_SEGMENT ? size : REG__HIVE_MAX_SEGMENT;
+            const uint8_t* segment = reg__hive_cell(hive, segment_offset, segment_size, NULL);
+            if (segment == NULL) return false;
+            sb_append_buf(sb, segment, segment_size);
+            size -= segment_size;
+        }
+        return size == 0;
+    }
+    const uint8_t* data = reg__hive_cell(hive, value->data, size, NULL);
+    if (data == NULL) return false;
+    sb_append_buf(sb, data, size);
+    return true;
+}
+
+bool reg_hive_key_list_values(const Registry_Hive* hive, uint32_t key_offset, Registry_Value_List* result) {
+    const Reg__Hive_Key* key = reg__hive_key(hive, key_offset);
+    if (key == NULL) {
+        nob_log(NOB_ERROR, "The key at offset %u of the hive is corrupted", key_offset);
+        return false;
+    }
+    if (key->value_count == 0) return true;
+    const uint8_t* list = reg__hive_cell(hive, key->value_list, (size_t) key->value_count * sizeof(uint32_t), NULL);
+    if (list == NULL) {
+        nob_log(NOB_ERROR, "The value list of the key at offset %u of the hive is corrupted", key_offset);
+        return false;
+    }
+
+    bool ok = true;
+    String_Builder name = {0};
+    String_Builder data = {0};
+    String_Builder utf8 = {0};
+    for (uint32_t i = 0; i < key->value_count && ok; ++i) {
+        uint32_t offset;
+        memcpy(&offset, list + i * sizeof(uint32_t), sizeof(offset));
+        const Reg__Hive_Value* value = reg__hive_value(hive, offset);
+        if (value == NULL) {
+            ok = false;
+            break;
+        }
+        name.count = 0;
+        reg__hive_append_name((const uint8_t*) (value + 1), value->name_len, value->flags & REG__HIVE_VALUE_COMP_NAME, &name);
+        data.count = 0;
+        if (!reg__hive_value_data(hive, value, &data)) {
+            ok = false;
+            break;
+        }
+
+        Registry_Value item = {.name_len = name.count};
+        item.name = NOB_REALLOC(NULL, name.count + 1);
+        memcpy(item.name, name.items, name.count);
+        item.name[name.count] = '\0';
+        if (value->type == 1) {
+            // REG_SZ is stored as UTF-16LE, convert it like the names
+            utf8.count = 0;
+            reg_utf16le_to_utf8((const unsigned char*) data.items, data.count, &utf8);
+            while (utf8.count > 0 && utf8.items[utf8.count - 1] == '\0') --utf8.count;
+            item.type = REG_TYPE_STRING;
+            item.data_len = utf8.count;
+            item.data = NOB_REALLOC(NULL, utf8.count + 1);
+            memcpy(item.data, utf8.items, utf8.count);
+        } else {
+            // Other types keep the bytes of the hive, which are the bytes regedit exports
+            item.type = REG_TYPE_HEX;
+            item.type_hex_type = value->type;
+            item.data_len = data.count;
+            item.data = NOB_REALLOC(NULL, data.count + 1);
+            memcpy(item.data, data.items, data.count);
+        }
+        // Ensure the data is null-terminated
+        item.data[item.data_len] = '\0';
+        da_append(result, item);
+    }
+    if (!ok) nob_log(NOB_ERROR, "A value of the key at offset %u of the hive is corrupted", key_offset);
+
+    sb_free(name);
+    sb_free(data);
+    sb_free(utf8);
+    return ok;
+}
+
+bool reg_hive_open_for_writing(const char* path, Registry_Hive* hive) {
+    return reg__hive_open(path, hive, true);
+}
+
+// Get the current time as a FILETIME, split in two halves
+static void reg__hive_now(uint32_t* low, uint32_t* high) {
+    // FILETIME counts 100 nanoseconds since 1601
+    uint64_t now = ((uint64_t) time(NULL) + 11644473600ull) * 10000000ull;
+    *low = (uint32_t) now;
+    *high = (uint32_t) (now >> 32);
+}
+
+static int32_t reg__hive_cell_size(const Registry_Hive* hive, uint32_t offset) {
+    int32_t size;
+    memcpy(&size, hive->bins + offset, sizeof(size));
+    return size;
+}
+
+// Write the size of a cell, which is negative for allocated cells
+static void reg__hive_set_cell_size(Registry_Hive* hive, uint32_t offset, int32_t size) {
+    memcpy(hive->bins + offset, &size, sizeof(size));
+}
+
+// Find the hive bin that contains offset, by looking back for its header, as hive bins start at multiples of 4096 bytes
+// Returns true if the hive bin was found, false otherwise
+static bool reg__hive_find_bin(const Registry_Hive* hive, uint32_t offset, uint32_t* bin, uint32_t* bin_size) {
+    uint32_t bins_size = hive->header->bins_size;
+    if (offset >= bins_size) return false;
+    for (uint32_t position = offset - offset % REG_HIVE_BLOCK_SIZE;; position -= REG_HIVE_BLOCK_SIZE) {
+        const Reg__Hive_Bin* header = (const Reg__Hive_Bin*) (hive->bins + position);
+        if (memcmp(header->magic, REG_HIVE_BIN_MAGIC, sizeof(header->magic)) == 0 && header->offset == position
+                && header->size >= REG_HIVE_BLOCK_SIZE && header->size <= bins_size - position) {
+            if (offset - position >= header->size) return false;
+            *bin = position;
+            *bin_size = header->size;
+            return true;
+        }
+        if (position == 0) return false;
+    }
+}
+
+// Allocate a cell of size bytes, including its size, from the free cells of a hive bin
+// Free cells that follow each other are merged along the way.
+// Returns the offset of the cell, or REG_HIVE_NO_CELL if the hive bin has no room
+static uint32_t reg__hive_alloc_in_bin(Registry_Hive* hive, uint32_t bin, uint32_t bin_size, uint32_t size) {
+    uint32_t end = bin + bin_size;
+    for (uint32_t offset = bin + sizeof(Reg__Hive_Bin); offset < end;) {
+        int32_t cell_size = reg__hive_cell_size(hive, offset);
+        uint32_t total_size = cell_size < 0 ? (uint32_t) -(int64_t) cell_size : (uint32_t) cell_size;
+        // Stop at corrupted cells, instead of allocating over them
+        if (total_size == 0 || total_size % 8 != 0 || total_size > end - offset) return REG_HIVE_NO_CELL;
+        if (cell_size > 0) {
+            uint32_t free_size = total_size;
+            while (free_size < end - offset) {
+                int32_t next_size = reg__hive_cell_size(hive, offset + free_size);
+                if (next_size <= 0 || next_size % 8 != 0 || (uint32_t) next_size > end - offset - free_size) break;
+                free_size += (uint32_t) next_size;
+            }
+            if (free_size >= size) {
+                if (free_size - size >= 8) {
+                    reg__hive_set_cell_size(hive, offset + size, (int32_t) (free_size - size));
+                } else {
+                    size = free_size;
+                }
+                reg__hive_set_cell_size(hive, offset, -(int32_t) size);
+                memset(hive->bins + offset + sizeof(int32_t), 0, size - sizeof(int32_t));
+                return offset;
+            }
+            if (free_size != total_size) reg__hive_set_cell_size(hive, offset, (int32_t) free_size);
+            total_size = free_size;
+        }
+        offset += total_size;
+    }
+    return REG_HIVE_NO_CELL;
+}
+
+// Add a hive bin at the end of the hive, and allocate a cell of size bytes, including its size, from it
+// Returns the offset of the cell, or REG_HIVE_NO_CELL on failure
+static uint32_t reg__hive_add_bin(Registry_Hive* hive, uint32_t size) {
+    uint32_t bin = hive->header->bins_size;
+    uint64_t bin_size = (uint64_t) size + sizeof(Reg__Hive_Bin);
+    if (bin_size < REG__HIVE_GROW_SIZE) bin_size = REG__HIVE_GROW_SIZE;
+    bin_size = (bin_size + REG_HIVE_BLOCK_SIZE - 1) / REG_HIVE_BLOCK_SIZE * REG_HIVE_BLOCK_SIZE;
+    if (bin_size > UINT32_MAX - bin) {
+        nob_log(NOB_ERROR, "Hive %s can't grow any further", hive->path);
+        return REG_HIVE_NO_CELL;
+    }
+
+    // The file may already have room after the hive bins, otherwise it is grown and mapped again
+    size_t file_size = sizeof(Registry_Hive_Header) + bin + (size_t) bin_size;
+    if (file_size > hive->size) {
+        unmap_file(sv_from_parts(hive->base, hive->size));
+        hive->header = NULL;
+        hive->bins = NULL;
+        if (!reg__map_file_shared(hive->path, hive->file, file_size, &hive->base, &hive->size)) {
+            hive->base = NULL;
+            return REG_HIVE_NO_CELL;
+        }
+        hive->header = hive->base;
+        hive->bins = (uint8_t*) hive->base + sizeof(Registry_Hive_Header);
+    }
+
+    Reg__Hive_Bin* header = (Reg__Hive_Bin*) (hive->bins + bin);
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, REG_HIVE_BIN_MAGIC, sizeof(header->magic));
+    header->offset = bin;
+    header->size = (uint32_t) bin_size;
+    reg__hive_now(&header->timestamp_low, &header->timestamp_high);
+    // The rest of the hive bin is a single free cell
+    reg__hive_set_cell_size(hive, bin + sizeof(Reg__Hive_Bin), (int32_t) (bin_size - sizeof(Reg__Hive_Bin)));
+    hive->header->bins_size += (uint32_t) bin_size;
+    hive->last_bin = bin;
+    return reg__hive_alloc_in_bin(hive, bin, (uint32_t) bin_size, size);
+}
+
+// Allocate a cell with room for size bytes of data, preferably in the hive bin of the cell at near
+// Allocating may map the hive again, which invalidates all pointers into it.
+// Returns the offset of the cell, or REG_HIVE_NO_CELL on failure
+static uint32_t reg__hive_alloc(Registry_Hive* hive, size_t size, uint32_t near) {
+    if (size > INT32_MAX - 16) {
+        nob_log(NOB_ERROR, "A cell of %zu bytes doesn't fit in hive %s", size, hive->path);
+        return REG_HIVE_NO_CELL;
+    }
+    uint32_t total_size = (uint32_t) (size + sizeof(int32_t) + 7) / 8 * 8;
+    uint32_t bin = REG_HIVE_NO_CELL;
+    uint32_t bin_size = 0;
+    if (reg__hive_find_bin(hive, near, &bin, &bin_size)) {
+        uint32_t offset = reg__hive_alloc_in_bin(hive, bin, bin_size, total_size);
+        if (offset != REG_HIVE_NO_CELL) return offset;
+    }
+    // New cells are kept together at the end
+    uint32_t last_bin = REG_HIVE_NO_CELL;
+    if (hive->last_bin == REG_HIVE_NO_CELL || !reg__hive_find_bin(hive, hive->last_bin, &last_bin, &bin_size)) {
+        reg__hive_find_bin(hive, hive->header->bins_size - 1, &last_bin, &bin_size);
+    }
+    if (last_bin != REG_HIVE_NO_CELL && last_bin != bin) {
+        hive->last_bin = last_bin;
+        uint32_t offset = reg__hive_alloc_in_bin(hive, last_bin, bin_size, total_size);
+        if (offset != REG_HIVE_NO_CELL) return offset;
+    }
+    return reg__hive_add_bin(hive, total_size);
+}
+
+// Mark an allocated cell as free
+static void reg__hive_free(Registry_Hive* hive, uint32_t offset) {
+    if (reg__hive_cell(hive, offset, 0, NULL) == NULL) return;
+    reg__hive_set_cell_size(hive, offset, -reg__hive_cell_size(hive, offset));
+}
+
+// Get the data of a cell that was just allocated
+static uint8_t* reg__hive_cell_data(Registry_Hive* hive, uint32_t offset) {
+    return hive->bins + offset + sizeof(int32_t);
+}
+
+// Check whether the data of a value is split over a db cell
+static bool reg__hive_is_big_data(const Registry_Hive* hive, uint32_t data_size) {
+    if (data_size & REG__HIVE_DATA_INLINE) return false;
+    return data_size > REG__HIVE_MAX_SEGMENT && hive->header->minor_version >= 4;
+}
+
+// Free the cells of the data of a value
+static void reg__hive_free_data(Registry_Hive* hive, uint32_t data, uint32_t data_size) {
+    if (data_size & REG__HIVE_DATA_INLINE || data_size == 0) return;
+    if (reg__hive_is_big_data(hive, data_size)) {
+        const Reg__Hive_Big_Data* big = (const Reg__Hive_Big_Data*) reg__hive_cell(hive, data, sizeof(Reg__Hive_Big_Data), NULL);
+        if (big != NULL && memcmp(big->magic, "db", 2) == 0) {
+            const uint8_t* segments = reg__hive_cell(hive, big->segment_list, (size_t) big->segment_count * sizeof(uint32_t), NULL);
+            for (uint16_t i = 0; segments != NULL && i < big->segment_count; ++i) {
+                uint32_t segment;
+                memcpy(&segment, segments + i * sizeof(uint32_t), sizeof(segment));
+                reg__hive_free(hive, segment);
+            }
+            reg__hive_free(hive, big->segment_list);
+        }
+    }
+    reg__hive_free(hive, data);
+}
+
+// Store data in new cells, and set the data and data size of the value at value_offset to them
+// Returns true on success, false on failure
+static bool reg__hive_store_data(Registry_Hive* hive, uint32_t value_offset, const uint8_t* data, size_t size) {
+    uint32_t data_field = 0;
+    uint32_t data_size = (uint32_t) size;
+    if (size <= sizeof(data_field)) {
+        // Small data is stored in the value cell itself
+        memcpy(&data_field, data, size);
+        data_size |= REG__HIVE_DATA_INLINE;
+    } else if (reg__hive_is_big_data(hive, data_size)) {
+        size_t segment_count = (size + REG__HIVE_MAX_SEGMENT - 1) / REG__HIVE_MAX_SEGMENT;
+        if (segment_count > UINT16_MAX) return false;
+        uint32_t list = reg__hive_alloc(hive, segment_count * sizeof(uint32_t), value_offset);
+        if (list == REG_HIVE_NO_CELL) return false;
+        for (size_t i = 0; i < segment_count; ++i) {
+            size_t segment_size = size - i * REG__HIVE_MAX_SEGMENT;
+            if (segment_size > REG__HIVE_MAX_SEGMENT) segment_size = REG__HIVE_MAX_SEGMENT;
+            uint32_t segment = reg__hive_alloc(hive, segment_size, value_offset);
+            if (segment == REG_HIVE_NO_CELL) return false;
+            memcpy(reg__hive_cell_data(hive, segment), data + i * REG__HIVE_MAX_SEGMENT, segment_size);
+            memcpy(reg__hive_cell_data(hive, list) + i * sizeof(uint32_t), &segment, sizeof(segment));
+        }
+        data_field = reg__hive_alloc(hive, sizeof(Reg__Hive_Big_Data), value_offset);
+        if (data_field == REG_HIVE_NO_CELL) return false;
+        Reg__Hive_Big_Data* big = (Reg__Hive_Big_Data*) reg__hive_cell_data(hive, data_field);
+        memcpy(big->magic, "db", 2);
+        big->segment_count = (uint16_t) segment_count;
+        big->segment_list = list;
+    } else {
+        data_field = reg__hive_alloc(hive, size, value_offset);
+        if (data_field == REG_HIVE_NO_CELL) return false;
+        memcpy(reg__hive_cell_data(hive, data_field), data, size);
+    }
+    Reg__Hive_Value* value = (Reg__Hive_Value*) reg__hive_cell_data(hive, value_offset);
+    value->data = data_field;
+    value->data_size = data_size;
+    return true;
+}
+
+// Convert UTF-8 to UTF-16LE, bytes that aren't valid UTF-8 are taken as Latin-1
+static void reg__utf8_to_utf16le(const char* string, size_t size, String_Builder* sb) {
+    const unsigned char* bytes = (const unsigned char*) string;
+    for (size_t i = 0; i < size;) {
+        uint32_t codepoint = bytes[i];
+        size_t length = 1;
+        if (codepoint >= 0xC0 && codepoint < 0xE0) length = 2;
+        else if (codepoint >= 0xE0 && codepoint < 0xF0) length = 3;
+        else if (codepoint >= 0xF0 && codepoint < 0xF8) length = 4;
+        bool valid = length > 1 && i + length <= size;
+        for (size_t j = 1; valid && j < length; ++j) valid = (bytes[i + j] & 0xC0) == 0x80;
+        if (valid) {
+            codepoint &= 0x7F >> length;
+            for (size_t j = 1; j < length; ++j) codepoint = codepoint << 6 | (bytes[i + j] & 0x3F);
+        } else {
+            length = 1;
+        }
+        i += length;
+
+        if (codepoint >= 0x10000) {
+            codepoint -= 0x10000;
+            uint16_t high = (uint16_t) (0xD800 + (codepoint >> 10));
+            uint16_t low = (uint16_t) (0xDC00 + (codepoint & 0x3FF));
+            sb_append_buf(sb, &high, sizeof(high));
+            sb_append_buf(sb, &low, sizeof(low));
+        } else {
+            uint16_t unit = (uint16_t) codepoint;
+            sb_append_buf(sb, &unit, sizeof(unit));
+        }
+    }
+}
+
+// Mark the hive as being written, before the first change
+// Returns true on success, false on failure
+static bool reg__hive_begin_write(Registry_Hive* hive) {
+    if (hive->dirty) return true;
+    // The sequence numbers differ until the hive is flushed, so an interrupted write can be detected
+    hive->header->primary_sequence += 1;
+    hive->header->checksum = reg__hive_checksum(hive->header);
+    hive->dirty = true;
+    return reg__flush_mapping(hive->path, hive->file, hive->base, sizeof(Registry_Hive_Header));
+}
+
+// Add, replace or delete a single value of the key at key_offset
+// Returns true on success, false on failure
+static bool reg__hive_set_value(Registry_Hive* hive, uint32_t key_offset, const Registry_Value* value, String_Builder* scratch, String_Builder* encoded) {
+    const Reg__Hive_Key* key = reg__hive_key(hive, key_offset);
+    if (key == NULL) return false;
+
+    // Find the value with the same name
+    uint32_t count = key->value_count;
+    uint32_t index = REG_HIVE_NO_CELL;
+    uint32_t value_offset = REG_HIVE_NO_CELL;
+    const uint8_t* list = NULL;
+    if (count > 0) {
+        list = reg__hive_cell(hive, key->value_list, (size_t) count * sizeof(uint32_t), NULL);
+        if (list == NULL) return false;
+    }
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t offset;
+        memcpy(&offset, list + i * sizeof(uint32_t), sizeof(offset));
+        const Reg__Hive_Value* existing = reg__hive_value(hive, offset);
+        if (existing == NULL) return false;
+        if (reg__hive_name_eq((const uint8_t*) (existing + 1), existing->name_len, existing->flags & REG__HIVE_VALUE_COMP_NAME, value->name, value->name_len, scratch)) {
+            index = i;
+            value_offset = offset;
+            break;
+        }
+    }
+
+    if (value->type == REG_TYPE_DELETE) {
+        // Deleting a value that doesn't exist doesn't change anything
+        if (index == REG_HIVE_NO_CELL) return true;
+        const Reg__Hive_Value* existing = reg__hive_value(hive, value_offset);
+        reg__hive_free_data(hive, existing->data, existing->data_size);
+        reg__hive_free(hive, value_offset);
+        Reg__Hive_Key* changed = (Reg__Hive_Key*) reg__hive_cell_data(hive, key_offset);
+        uint8_t* changed_list = reg__hive_cell_data(hive, changed->value_list);
+        memmove(changed_list + index * sizeof(uint32_t), changed_list + (index + 1) * sizeof(uint32_t), (count - index - 1) * sizeof(uint32_t));
+        changed->value_count -= 1;
+        if (changed->value_count == 0) {
+            reg__hive_free(hive, changed->value_list);
+            changed->value_list = REG_HIVE_NO_CELL;
+        }
+        reg__hive_now(&changed->last_write_time_low, &changed->last_write_time_high);
+        return true;
+    }
+
+    // Encode the data the way the hive stores it
+    encoded->count = 0;
+    uint32_t type = value->type_hex_type;
+    if (value->type == REG_TYPE_STRING) {
+        const char* string = value->data != NULL ? value->data : "";
+        reg__utf8_to_utf16le(string, reg_value_string_len(value), encoded);
+        sb_append_buf(encoded, "\0", 2);
+        // REG_SZ
+        type = 1;
+    } else if (value->data_len > 0) {
+        sb_append_buf(encoded, value->data, value->data_len);
+    }
+
+    // Names that are ASCII are stored as Latin-1
+    bool ascii = true;
+    for (size_t i = 0; i < value->name_len && ascii; ++i) ascii = (unsigned char) value->name[i] < 0x80;
+    scratch->count = 0;
+    if (ascii) sb_append_buf(scratch, value->name, value->name_len);
+    else reg__utf8_to_utf16le(value->name, value->name_len, scratch);
+    if (scratch->count > UINT16_MAX) return false;
+
+    if (index == REG_HIVE_NO_CELL) {
+        value_offset = reg__hive_alloc(hive, sizeof(Reg__Hive_Value) + scratch->count, key_offset);
+        if (value_offset == REG_HIVE_NO_CELL) return false;
+        Reg__Hive_Value* added = (Reg__Hive_Value*) reg__hive_cell_data(hive, value_offset);
+        memcpy(added->magic, "vk", 2);
+        added->name_len = (uint16_t) scratch->count;
+        added->data_size = REG__HIVE_DATA_INLINE;
+        added->flags = ascii ? REG__HIVE_VALUE_COMP_NAME : 0;
+        memcpy(added + 1, scratch->items, scratch->count);
+
+        // Add the value to the value list, which gets some room to spare when it needs to grow
+        size_t capacity = 0;
+        if (count > 0) reg__hive_cell(hive, reg__hive_key(hive, key_offset)->value_list, 0, &capacity);
+        if (capacity < (count + 1) * sizeof(uint32_t)) {
+            uint32_t new_list = reg__hive_alloc(hive, (count + count / 2 + 1) * sizeof(uint32_t), key_offset);
+            if (new_list == REG_HIVE_NO_CELL) return false;
+            Reg__Hive_Key* changed = (Reg__Hive_Key*) reg__hive_cell_data(hive, key_offset);
+            if (count > 0) {
+                memcpy(reg__hive_cell_data(hive, new_list), reg__hive_cell_data(hive, changed->value_list), count * sizeof(uint32_t));
+                reg__hive_free(hive, changed->value_list);
+            }
+            changed->value_list = new_list;
+        }
+        Reg__Hive_Key* changed = (Reg__Hive_Key*) reg__hive_cell_data(hive, key_offset);
+        memcpy(reg__hive_cell_data(hive, changed->value_list) + count * sizeof(uint32_t), &value_offset, sizeof(value_offset));
+        changed->value_count += 1;
+    }
+
+    Reg__Hive_Value* changed_value = (Reg__Hive_Value*) reg__hive_cell_data(hive, value_offset);
+    uint32_t old_data = changed_value->data;
+    uint32_t old_size = changed_value->data_size;
+    size_t old_capacity = 0;
+    bool in_place = index != REG_HIVE_NO_CELL && encoded->count > sizeof(uint32_t)
+                 && !(old_size & REG__HIVE_DATA_INLINE) && !reg__hive_is_big_data(hive, old_size)
+                 && !reg__hive_is_big_data(hive, (uint32_t) encoded->count)
+                 && reg__hive_cell(hive, old_data, 0, &old_capacity) != NULL && old_capacity >= encoded->count;
+    if (in_place) {
+        // Data that fits in the cell of the old data only changes the pages of that cell
+        memcpy(reg__hive_cell_data(hive, old_data), encoded->items, encoded->count);
+        changed_value->data_size = (uint32_t) encoded->count;
+    } else {
+        // The old data is only freed once the new data is stored
+        if (!reg__hive_store_data(hive, value_offset, (const uint8_t*) encoded->items, encoded->count)) return false;
+        if (index != REG_HIVE_NO_CELL) reg__hive_free_data(hive, old_data, old_size);
+        changed_value = (Reg__Hive_Value*) reg__hive_cell_data(hive, value_offset);
+    }
+    changed_value->type = type;
+
+    // Keep the sizes that Windows uses to size its buffers up to date
+    Reg__Hive_Key* changed = (Reg__Hive_Key*) reg__hive_cell_data(hive, key_offset);
+    uint32_t name_size = ascii ? (uint32_t) scratch->count * 2 : (uint32_t) scratch->count;
+    if (changed->max_value_name_len < name_size) changed->max_value_name_len = name_size;
+    if (changed->max_value_data_len < encoded->count) changed->max_value_data_len = (uint32_t) encoded->count;
+    reg__hive_now(&changed->last_write_time_low, &changed->last_write_time_high);
+    return true;
+}
+
+bool reg_hive_key_apply(Registry_Hive* hive, uint32_t key, const Registry_Value_List patch) {
+    NOB_ASSERT(hive->path != NULL && "The hive is not opened for writing");
+    if (patch.count == 0) return true;
+    if (!reg__hive_begin_write(hive)) return false;
+
+    bool result = true;
+    String_Builder scratch = {0};
+    String_Builder encoded = {0};
+    for (size_t i = 0; i < patch.count && result; ++i) {
+        result = reg__hive_set_value(hive, key, &patch.items[i], &scratch, &encoded);
+        if (!result) nob_log(NOB_ERROR, "Couldn't write value %.*s to the key at offset %u of hive %s", (int) patch.items[i].name_len, patch.items[i].name, key, hive->path);
+    }
+    sb_free(scratch);
+    sb_free(encoded);
+    return result;
+}
+
+bool reg_hive_flush(Registry_Hive* hive) {
+    if (!hive->dirty) return true;
+    // Every cell needs to be on the disk before the hive is marked as complete
+    if (!reg__flush_mapping(hive->path, hive->file, hive->base, hive->size)) return false;
+    Registry_Hive_Header* header = hive->header;
+    header->secondary_sequence = header->primary_sequence;
+    reg__hive_now(&header->last_write_time_low, &header->last_write_time_high);
+    header->checksum = reg__hive_checksum(header);
+    if (!reg__flush_mapping(hive->path, hive->file, hive->base, sizeof(*header))) return false;
+    hive->dirty = false;
+    return true;
+}
+
+void reg_hive_close(Registry_Hive* hive) {
+    if (hive->base != NULL) unmap_file(sv_from_parts(hive->base, hive->size));
+    if (hive->path != NULL) fd_close(hive->file);
+    memset(hive, 0, sizeof(*hive));
+}
+
+#ifdef _WIN32
+bool reg_key_query_info(HKEY key, DWORD* amount_of_values, uint64_t* last_write_time) {
+    FILETIME last_write;
+    REG_TRACE_EVENT("RegQueryInfoKeyA", 'B', -1);
+    long code = RegQueryInfoKeyA(key, NULL, NULL, NULL, NULL /*Amount of subkeys*/, NULL, NULL, amount_of_values, NULL, NULL, NULL, &last_write);
+    REG_TRACE_EVENT("RegQueryInfoKeyA", 'E', -1);
+    if (code != ERROR_SUCCESS) {
+        nob_log(NOB_ERROR, "Couldn't query registry key info: %ld", code);
+        return false;
+    }
+    *last_write_time = ((uint64_t) last_write.dwHighDateTime << 32) | last_write.dwLowDateTime;
+    return true;
+}
+
+bool reg_key_enumerate_values(HKEY parent_key, DWORD amount_of_values, Registry_Value_List* result) {
+    char value_name[REG_MAX_VALUE_NAME];
+    unsigned char value_data[REG_MAX_VALUE_DATA+1];
+    long code;
+
+    // Add all of the values to the list
+    for (DWORD i = 0; i < amount_of_values; ++i) {
+        Registry_Value key = {0};
+
+        // Trace the RegEnumValueA calls in batches, to keep the trace readable for big keys
+        if (i % REG_TRACE_BATCH == 0) {
+            if (i > 0) REG_TRACE_EVENT("RegEnumValueA batch", 'E', -1);
+            REG_TRACE_EVENT("RegEnumValueA batch", 'B', i);
+        }
+
+        DWORD value_len = REG_MAX_VALUE_NAME;
+        DWORD value_type;
+        DWORD data_len = REG_MAX_VALUE_DATA;
+        // Retrieve the name and data of this value
+        code = RegEnumValueA(parent_key, i, value_name, &value_len, NULL, &value_type, value_data, &data_len);
+        if (code != ERROR_SUCCESS) {
+            REG_TRACE_EVENT("RegEnumValueA batch", 'E', -1);
+            nob_log(NOB_ERROR, "Couldn't enumerate value %ld of %ld: %ld", i, amount_of_values, code);
+            return false;
+        }
+        // Copy the name to the registry value
+        key.name_len = value_len;
+        key.name = NOB_REALLOC(NULL, sizeof(*value_name) * (value_len + 1));
+        memcpy(key.name, value_name, sizeof(*value_name) * value_len);
+        // Ensure the name is null-terminated
+        key.name[value_len] = 0;
+
+        // Copy the data to the registry value
+        key.data_len = data_len;
+        key.data = NOB_REALLOC(NULL, sizeof(*value_data) * (data_len + 1));
+        memcpy(key.data, value_data, sizeof(*value_data) * data_len);
+        // Ensure the data is null-terminated
+        key.data[data_len] = 0;
+
+        // Assign the correct type
+        if (value_type == REG_SZ) {
+            key.type = REG_TYPE_STRING;
+        } else {
+            key.type = REG_TYPE_HEX;
+            key.type_hex_type = value_type;
+        }
+
+        // Add the registry value to the list
+        da_append(result, key);
+    }
+    if (amount_of_values > 0) REG_TRACE_EVENT("RegEnumValueA batch", 'E', -1);
+
+    return true;
+}
+
+bool reg_key_list_values(HKEY parent_key, Registry_Value_List* result) {
+    DWORD amount_of_values = 0;
+    uint64_t last_write_time = 0;
+    if (!reg_key_query_info(parent_key, &amount_of_values, &last_write_time)) return false;
+    return reg_key_enumerate_values(parent_key, amount_of_values, result);
+}
+
+bool reg_key_apply(HKEY key, const Registry_Value_List patch) {
+    bool result = true;
+    // The names and string data can be views, but the registry functions take C strings
+    String_Builder name = {0};
+    String_Builder data = {0};
+    for (size_t i = 0; i < patch.count; ++i) {
+        const Registry_Value* value = &patch.items[i];
+        name.count = 0;
+        sb_append_buf(&name, value->name, value->name_len);
+        sb_append_null(&name);
+        // Trace the writes in batches, like the reads
+        if (i % REG_TRACE_BATCH == 0) {
+            if (i > 0) REG_TRACE_EVENT("RegSetValueExA batch", 'E', -1);
+            REG_TRACE_EVENT("RegSetValueExA batch", 'B', i);
+        }
+
+        long code = ERROR_SUCCESS;
+        switch (value->type) {
+        case REG_TYPE_STRING:
+            data.count = 0;
+            sb_append_buf(&data, value->data, reg_value_string_len(value));
+            sb_append_null(&data);
+            // The size of a REG_SZ includes its NUL
+            code = RegSetValueExA(key, name.items, 0, REG_SZ, (const BYTE*) data.items, (DWORD) data.count);
+            break;
+        case REG_TYPE_HEX:
+            code = RegSetValueExA(key, name.items, 0, value->type_hex_type, (const BYTE*) value->data, (DWORD) value->data_len);
+            break;
+        case REG_TYPE_DELETE:
+            code = RegDeleteValueA(key, name.items);
+            // The value is already gone
+            if (code == ERROR_FILE_NOT_FOUND) code = ERROR_SUCCESS;
+            break;
+        }
+        if (code != ERROR_SUCCESS) {
+            nob_log(NOB_ERROR, "Couldn't write registry value %s: %ld", name.items, code);
+            return_defer(false);
+        }
+    }
+
+defer:
+    if (patch.count > 0) REG_TRACE_EVENT("RegSetValueExA batch", 'E', -1);
+    sb_free(name);
+    sb_free(data);
+    return result;
+}
+
+bool reg_key_verify_patch(HKEY key, const Registry_Value_List patch) {
+    Registry_Value_List current = {0};
+    if (!reg_key_list_values(key, &current)) return false;
+
+    Registry_Key_Diff diff = {0};
+    reg_key_diff(current, patch, &diff);
+    bool result = diff.patch.count == 0;
+    if (!result) {
+        const Registry_Value* value = &diff.patch.items[0];
+        nob_log(NOB_ERROR, "%zu registry values don't have the value that was written, e.g. %.*s", diff.patch.count, (int) value->name_len, value->name);
+    }
+    reg_key_diff_free(&diff);
+    reg_value_list_free(&current);
+    return result;
+}
+
+bool reg_snapshot_apply(const Registry_Snapshot* snapshot) {
+    bool result = true;
+    Registry_Key key = {0};
+    for (uint32_t i = 0; i < snapshot->header->key_count && result; ++i) {
+        // Every path in the string table is followed by a NUL
+        const char* path = snapshot->strings + snapshot->keys[i].path_offset;
+        key.list.count = 0;
+        reg__snapshot_key_values(snapshot, i, &key);
+
+        HKEY handle;
+        long code = RegOpenKeyExA(HKEY_LOCAL_MACHINE, path, 0, KEY_READ | KEY_SET_VALUE, &handle);
+        if (code != ERROR_SUCCESS) {
+            nob_log(NOB_ERROR, "Failed to open key %s: %ld", path, code);
+            result = false;
+            break;
+        }
+        result = reg_key_apply(handle, key.list) && reg_key_verify_patch(handle, key.list);
+        RegCloseKey(handle);
+    }
+    da_free(key.list);
+    return result;
+}
+#endif // _WIN32
+
+#endif // REGISTRY_IMPLEMENTATION
@@ -0,0 +1,74 @@
+#define NOB_IMPLEMENTATION
+#define NOB_STRIP_PREFIX
+#include "nob.h"
+// Undefine the log error types, because it conflicts with windows.h
+#undef ERROR
+#undef INFO
+#undef WARNING
+
+#include <stdio.h>
+#include <string.h>
+
+#define REGISTRY_IMPLEMENTATION
+#include "registry.h"
+
+void log_usage(Nob_Log_Level level, const char* program) {
+    nob_log(level, "Usage: %s <command> <input> <output>", program);
+}
+
+void log_options(Nob_Log_Level level) {
+    nob_log(level, "Available commands:");
+    nob_log(level, "  compress     Compress a .reg file or snapshot");
+    nob_log(level, "  decompress   Decompress a file written by compress or by changefont --compress");
+}
+
+int main(int argc, char** argv) {
+    int result = 0;
+    FILE* in = NULL;
+    FILE* out = NULL;
+
+    const char* program = shift(argv, argc);
+    if (argc == 1 && strcmp(argv[0], "--help") == 0) {
+        log_usage(NOB_INFO, program);
+        log_options(NOB_INFO);
+        return 0;
+    }
+    if (argc != 3) {
+        log_usage(NOB_ERROR, program);
+        log_options(NOB_ERROR);
+        return 1;
+    }
+    const char* command = shift(argv, argc);
+    const char* input_path = shift(argv, argc);
+    const char* output_path = shift(argv, argc);
+    bool compress = strcmp(command, "compress") == 0;
+    if (!compress && strcmp(command, "decompress") != 0) {
+        log_usage(NOB_ERROR, program);
+        log_options(NOB_ERROR);
+        nob_log(NOB_ERROR, "Invalid command %s", command);
+        return 1;
+    }
+
+    in = fopen(input_path, "rb");
+    if (in == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", input_path, strerror(errno));
+        return_defer(1);
+    }
+    out = fopen(output_path, "wb");
+    if (out == NULL) {
+        nob_log(NOB_ERROR, "Couldn't open %s: %s", output_path, strerror(errno));
+        return_defer(1);
+    }
+
+    // Both directions work one block at a time, so files of any size only need a few blocks of memory
+    bool ok = compress ? reg_lz_compress_stream(in, out) : reg_lz_decompress_stream(input_path, in, out);
+    if (!ok) return_defer(1);
+
+defer:
+    if (in != NULL) fclose(in);
+    if (out != NULL && fclose(out) != 0) {
+        nob_log(NOB_ERROR, "Couldn't write %s: %s", output_path, strerror(errno));
+        result = 1;
+    }
+    return result;
+}
@@ -0,0 +1,102 @@
+// Ordering test of the asynchronous mode of nob_log
+//
+// Several threads log numbered messages at once, with standard error redirected to a file next to the executable.
+// Every message has to end up in the file exactly once, as a whole line, and the messages of every thread in the order
+// they were logged.
+
+// A small ring, so the threads that log often find it full and have to wait for the writer thread
+#define NOB_LOG_ASYNC_CAPACITY 64
+#define NOB_IMPLEMENTATION
+#define NOB_STRIP_PREFIX
+#include "../src/nob.h"
+
+#include <unistd.h>
+
+#define LOG_THREADS 4
+#define LOG_MESSAGES 50000
+// Every so many messages is too long for a slot of the ring, so it takes the allocated path
+#define LOG_LONG_EVERY 1000
+
+void log_messages(void* arg, size_t thread, size_t worker) {
+    UNUSED(arg);
+    UNUSED(worker);
+    for (size_t i = 0; i < LOG_MESSAGES; ++i) {
+        if (i % LOG_LONG_EVERY == LOG_LONG_EVERY - 1) {
+            nob_log(WARNING, "t=%zu m=%zu %0300d", thread, i, 7);
+        } else {
+            nob_log(i % 2 ? INFO : ERROR, "t=%zu m=%zu machine pc0001 doesn't have font Arial", thread, i);
+        }
+    }
+}
+
+// Log the messages from all threads to a file, in the background
+void log_to_file(Thread_Pool* pool, const char* path) {
+    fflush(stderr);
+    int saved = dup(fileno(stderr));
+    if (saved < 0 || freopen(path, "w", stderr) == NULL) {
+        fprintf(stdout, "Could not redirect standard error to %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+
+    if (!log_async_start()) exit(1);
+    parallel_for(pool, 0, LOG_THREADS, 1, log_messages, NULL);
+    // Stopping writes the messages that are still queued
+    log_async_stop();
+
+    fflush(stderr);
+    dup2(saved, fileno(stderr));
+    close(saved);
+}
+
+// Check that every message of every thread is in a file once, in order
+// Returns true on success, false on failure
+bool check_file(const char* path) {
+    bool result = true;
+    String_Builder sb = {0};
+    size_t next[LOG_THREADS] = {0};
+    if (!read_entire_file(path, &sb)) return_defer(false);
+
+    String_View content = sb_to_sv(sb);
+    size_t line_number = 0;
+    while (content.count > 0) {
+        String_View line = sv_chop_by_delim(&content, '\n');
+        line_number += 1;
+        // sscanf would look for the end of the whole file, so the start of the line is copied first
+        char start[64] = {0};
+        memcpy(start, line.data, line.count < sizeof(start) - 1 ? line.count : sizeof(start) - 1);
+        size_t thread, message;
+        const char* fields = strchr(start, 't');
+        if (fields == NULL || sscanf(fields, "t=%zu m=%zu", &thread, &message) != 2 || thread >= LOG_THREADS) {
+            nob_log(ERROR, "%s:%zu: unexpected line "SV_Fmt, path, line_number, SV_Arg(line));
+            return_defer(false);
+        }
+        if (message != next[thread]) {
+            nob_log(ERROR, "%s:%zu: message %zu of thread %zu comes after message %zu", path, line_number, message, thread, next[thread] - 1);
+            return_defer(false);
+        }
+        next[thread] += 1;
+    }
+    for (size_t i = 0; i < LOG_THREADS; ++i) {
+        if (next[i] != LOG_MESSAGES) {
+            nob_log(ERROR, "%s: only %zu of %d messages of thread %zu were written", path, next[i], LOG_MESSAGES, i);
+            return_defer(false);
+        }
+    }
+
+defer:
+    sb_free(sb);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const char* program = shift(argv, argc);
+    const char* path = temp_sprintf("%s.txt", program);
+    // The calling thread logs as well
+    Thread_Pool* pool = thread_pool_create(LOG_THREADS - 1);
+    log_to_file(pool, path);
+    thread_pool_destroy(pool);
+
+    if (!check_file(path)) return 1;
+    nob_log(INFO, "%d threads logged %d messages each, which were all written in order", LOG_THREADS, LOG_MESSAGES);
+    return 0;
+}
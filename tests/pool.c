@@ -0,0 +1,172 @@
+// Stress test and scaling benchmark of the work-stealing thread pool of nob.h
+//
+// Usage: pool            run the stress test
+//        pool bench [N]  measure the throughput with 1 thread and with up to N threads (default: processor count)
+
+#define NOB_IMPLEMENTATION
+#define NOB_STRIP_PREFIX
+#include "../src/nob.h"
+
+#include <time.h>
+
+// Largest amount of extra threads the stress test starts a pool with
+#define STRESS_MAX_THREADS 4
+#define STRESS_REPEATS 20
+#define STRESS_OUTER 200
+// Items of the benchmark, which cost from 1 to BENCH_COST_STEPS spin loops so the threads need to steal
+#define BENCH_ITEMS 4096
+#define BENCH_COST_STEPS 16
+#define BENCH_SPIN 4000
+#define BENCH_RUNS 3
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+typedef struct {
+    Thread_Pool* pool;
+    long total;
+    // Amount of times every index of the outer loop was run
+    long visits[STRESS_OUTER];
+    // Set when a body was called with a worker index that is out of range
+    long bad_worker;
+} Stress;
+
+void stress_inner(void* arg, size_t index, size_t worker) {
+    UNUSED(worker);
+    long* sum = arg;
+    __atomic_add_fetch(sum, (long) index, __ATOMIC_RELAXED);
+}
+
+// Every index of the outer loop runs a loop of its own on the same pool, so waiting threads have to run tasks
+void stress_outer(void* arg, size_t index, size_t worker) {
+    Stress* stress = arg;
+    if (worker > thread_pool_thread_count(stress->pool)) __atomic_store_n(&stress->bad_worker, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stress->visits[index], 1, __ATOMIC_RELAXED);
+    long sum = 0;
+    parallel_for(stress->pool, 0, 100 + index, 3, stress_inner, &sum);
+    __atomic_add_fetch(&stress->total, sum, __ATOMIC_RELAXED);
+}
+
+typedef struct {
+    Thread_Pool* pool;
+    Task_Group* group;
+    long depth;
+    long* count;
+} Tree;
+
+// A task that submits two more tasks to its group, until the tree is deep enough
+void tree_task(void* arg) {
+    Tree* tree = arg;
+    __atomic_add_fetch(tree->count, 1, __ATOMIC_RELAXED);
+    if (tree->depth > 0) {
+        for (size_t i = 0; i < 2; ++i) {
+            Tree* child = malloc(sizeof(*child));
+            assert(child != NULL && "Buy more RAM lol");
+            *child = (Tree) {.pool = tree->pool, .group = tree->group, .depth = tree->depth - 1, .count = tree->count};
+            thread_pool_submit(tree->pool, tree->group, tree_task, child);
+        }
+    }
+    free(tree);
+}
+
+// Returns true on success, false on failure
+bool stress(size_t threads) {
+    bool result = true;
+    Thread_Pool* pool = thread_pool_create(threads);
+    for (size_t repeat = 0; repeat < STRESS_REPEATS; ++repeat) {
+        Stress stress = {.pool = pool};
+        parallel_for(pool, 0, STRESS_OUTER, 1, stress_outer, &stress);
+        long expected = 0;
+        for (long i = 0; i < STRESS_OUTER; ++i) {
+            long n = 100 + i;
+            expected += n * (n - 1) / 2;
+            if (stress.visits[i] != 1) {
+                nob_log(ERROR, "%zu threads: index %ld was run %ld times", threads, i, stress.visits[i]);
+                return_defer(false);
+            }
+        }
+        if (stress.total != expected) {
+            nob_log(ERROR, "%zu threads: nested loops summed to %ld instead of %ld", threads, stress.total, expected);
+            return_defer(false);
+        }
+        if (stress.bad_worker) {
+            nob_log(ERROR, "%zu threads: a body got a worker index out of range", threads);
+            return_defer(false);
+        }
+
+        long count = 0;
+        Tree* root = malloc(sizeof(*root));
+        assert(root != NULL && "Buy more RAM lol");
+        *root = (Tree) {.pool = pool, .group = task_group_create(), .depth = 10, .count = &count};
+        Task_Group* group = root->group;
+        thread_pool_submit(pool, group, tree_task, root);
+        task_group_wait(pool, group);
+        if (count != (1 << 11) - 1) {
+            nob_log(ERROR, "%zu threads: a task group finished after %ld of %d tasks", threads, count, (1 << 11) - 1);
+            return_defer(false);
+        }
+    }
+    nob_log(INFO, "%zu threads: nested loops and task trees are correct", thread_pool_thread_count(pool) + 1);
+
+defer:
+    thread_pool_destroy(pool);
+    return result;
+}
+
+void bench_item(void* arg, size_t index, size_t worker) {
+    UNUSED(arg);
+    UNUSED(worker);
+    volatile double x = (double) index;
+    size_t spins = BENCH_SPIN * (index % BENCH_COST_STEPS + 1);
+    for (size_t i = 0; i < spins; ++i) x = x * 1.0000001 + 1.0;
+}
+
+// Get the throughput of the benchmark with a pool of threads - 1 threads and the calling thread, in items per second
+double bench(size_t threads) {
+    Thread_Pool* pool = thread_pool_create(threads - 1);
+    double best = 0.0;
+    for (size_t run = 0; run < BENCH_RUNS; ++run) {
+        double start = now_seconds();
+        parallel_for(pool, 0, BENCH_ITEMS, 8, bench_item, NULL);
+        double seconds = now_seconds() - start;
+        double throughput = seconds > 0 ? BENCH_ITEMS / seconds : 0.0;
+        if (throughput > best) best = throughput;
+    }
+    thread_pool_destroy(pool);
+    return best;
+}
+
+int main(int argc, char** argv) {
+    const char* program = shift(argv, argc);
+    if (argc > 0 && strcmp(argv[0], "bench") == 0) {
+        shift(argv, argc);
+        size_t max_threads = processor_count();
+        if (argc > 0) {
+            max_threads = strtoul(shift(argv, argc), NULL, 10);
+            if (max_threads == 0) {
+                nob_log(ERROR, "Usage: %s bench [threads]", program);
+                return 1;
+            }
+        }
+
+        // Powers of two up to the maximum, and the maximum itself
+        double single = bench(1);
+        printf("%8s %16s %8s\n", "Threads", "Items per second", "Speedup");
+        printf("%8d %16.1f %8.2f\n", 1, single, 1.0);
+        for (size_t threads = 2; threads / 2 < max_threads; threads *= 2) {
+            if (threads > max_threads) threads = max_threads;
+            double throughput = bench(threads);
+            printf("%8zu %16.1f %8.2f\n", threads, throughput, single > 0 ? throughput / single : 0.0);
+            if (threads == max_threads) break;
+        }
+        return 0;
+    }
+
+    for (size_t threads = 0; threads <= STRESS_MAX_THREADS; ++threads) {
+        if (!stress(threads)) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,194 @@
+// Test of the patches of regdiff
+//
+// Writes pairs of .reg files next to the executable, runs regdiff on them and imports the patch into the keys of the
+// old file the way regedit does. The result has to be the keys of the new file.
+
+#define NOB_IMPLEMENTATION
+#define NOB_STRIP_PREFIX
+#include "../src/nob.h"
+#undef ERROR
+#undef INFO
+#undef WARNING
+
+#define REGISTRY_IMPLEMENTATION
+#include "../src/registry.h"
+
+// ./nob builds the portable tools for the host before it runs the tests
+#define REGDIFF_PATH "./build/native/regdiff"
+
+typedef struct {
+    const char* name;
+    const char* old_file;
+    const char* new_file;
+} Diff_Case;
+
+#define HEADER "Windows Registry Editor Version 5.00\n"
+
+const Diff_Case cases[] = {
+    {
+        "changed values",
+        HEADER"[HKEY_LOCAL_MACHINE\\A]\n\"keep\"=\"same\"\n\"y\"=\"1\"\n\"gone\"=\"x\"\n",
+        HEADER"[HKEY_LOCAL_MACHINE\\A]\n\"keep\"=\"same\"\n\"y\"=\"2\"\n\"new\"=dword:00000001\n",
+    },
+    {
+        "deleted key with its subkeys",
+        HEADER"[HKEY_LOCAL_MACHINE\\A]\n\"x\"=\"1\"\n[HKEY_LOCAL_MACHINE\\A\\B]\n\"y\"=\"1\"\n[HKEY_LOCAL_MACHINE\\B]\n\"z\"=\"1\"\n",
+        HEADER"[HKEY_LOCAL_MACHINE\\B]\n\"z\"=\"1\"\n",
+    },
+    {
+        // Deleting A would delete A\B as well, which only gets the value that changed
+        "deleted key that keeps a subkey",
+        HEADER"[HKEY_LOCAL_MACHINE\\A]\n\"x\"=\"1\"\n[HKEY_LOCAL_MACHINE\\A\\B]\n\"keep\"=\"same\"\n\"y\"=\"1\"\n",
+        HEADER"[HKEY_LOCAL_MACHINE\\A\\B]\n\"keep\"=\"same\"\n\"y\"=\"2\"\n",
+    },
+    {
+        // A B sorts between A and its subkeys
+        "deleted key that keeps a subkey after a sibling",
+        HEADER"[HKEY_LOCAL_MACHINE\\A]\n\"x\"=\"1\"\n[HKEY_LOCAL_MACHINE\\A B]\n\"x\"=\"1\"\n[HKEY_LOCAL_MACHINE\\a\\c]\n\"keep\"=\"same\"\n",
+        HEADER"[HKEY_LOCAL_MACHINE\\A B]\n\"x\"=\"1\"\n[HKEY_LOCAL_MACHINE\\A\\C]\n\"keep\"=\"same\"\n",
+    },
+    {
+        "key that is deleted in the new file, which keeps a subkey",
+        HEADER"[HKEY_LOCAL_MACHINE\\A]\n\"x\"=\"1\"\n[HKEY_LOCAL_MACHINE\\A\\B]\n\"keep\"=\"same\"\n",
+        HEADER"[-HKEY_LOCAL_MACHINE\\A]\n[HKEY_LOCAL_MACHINE\\A\\B]\n\"keep\"=\"same\"\n",
+    },
+};
+
+// The keys of a registry while a patch is imported, of which the names and data belong to the files
+typedef struct {
+    Registry_Key* items;
+    size_t count;
+    size_t capacity;
+} State;
+
+bool is_key_or_subkey(const char* path, const char* key) {
+    size_t key_len = strlen(key);
+    size_t len = strlen(path);
+    if (len < key_len || reg_name_compare(path, key_len, key, key_len) != 0) return false;
+    return len == key_len || path[key_len] == '\\';
+}
+
+// Import the keys of a patch like regedit, in the order of the patch, so keys are deleted before their subkeys are written
+void import_patch(State* state, const Registry_File* patch) {
+    for (size_t i = 0; i < patch->keys.count; ++i) {
+        const Registry_Key* patch_key = &patch->keys.items[i];
+        if (patch_key->deleted) {
+            size_t kept = 0;
+            for (size_t j = 0; j < state->count; ++j) {
+                if (is_key_or_subkey(state->items[j].path, patch_key->path)) {
+                    da_free(state->items[j].list);
+                } else {
+                    state->items[kept++] = state->items[j];
+                }
+            }
+            state->count = kept;
+            continue;
+        }
+
+        Registry_Key* key = NULL;
+        for (size_t j = 0; j < state->count && key == NULL; ++j) {
+            if (reg_name_compare(state->items[j].path, strlen(state->items[j].path), patch_key->path, strlen(patch_key->path)) == 0) {
+                key = &state->items[j];
+            }
+        }
+        if (key == NULL) {
+            da_append(state, ((Registry_Key) {.path = patch_key->path}));
+            key = &state->items[state->count - 1];
+        }
+        for (size_t j = 0; j < patch_key->list.count; ++j) {
+            const Registry_Value* value = &patch_key->list.items[j];
+            size_t kept = 0;
+            for (size_t k = 0; k < key->list.count; ++k) {
+                if (reg_name_compare(key->list.items[k].name, key->list.items[k].name_len, value->name, value->name_len) != 0) {
+                    key->list.items[kept++] = key->list.items[k];
+                }
+            }
+            key->list.count = kept;
+            if (value->type != REG_TYPE_DELETE) da_append(&key->list, *value);
+        }
+    }
+}
+
+// Check that the keys of a registry are the keys of a file
+// Keys without values that aren't in the file are allowed, as they can be parents of keys in the file.
+// Returns true on success, false on failure
+bool check_state(const char* name, const State* state, const Registry_File* file) {
+    for (size_t i = 0; i < state->count; ++i) {
+        const Registry_Key* key = &state->items[i];
+        Registry_Key* expected = reg_file_find_key(file, key->path);
+        if ((expected == NULL || expected->deleted) && key->list.count > 0) {
+            nob_log(NOB_ERROR, "%s: the patch keeps key %s", name, key->path);
+            return false;
+        }
+    }
+    for (size_t i = 0; i < file->keys.count; ++i) {
+        const Registry_Key* expected = &file->keys.items[i];
+        if (expected->deleted) continue;
+        const Registry_Key* key = NULL;
+        for (size_t j = 0; j < state->count && key == NULL; ++j) {
+            if (reg_name_compare(state->items[j].path, strlen(state->items[j].path), expected->path, strlen(expected->path)) == 0) {
+                key = &state->items[j];
+            }
+        }
+        const Registry_Value_List empty = {0};
+        Registry_Key_Diff diff = {0};
+        reg_key_diff_states(key == NULL ? empty : key->list, expected->list, &diff);
+        size_t differences = diff.patch.count;
+        reg_key_diff_free(&diff);
+        if (differences > 0) {
+            nob_log(NOB_ERROR, "%s: after the patch, %zu values of key %s differ", name, differences, expected->path);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns true on success, false on failure
+bool run_case(const char* program, const Diff_Case* diff_case) {
+    bool result = true;
+    Cmd cmd = {0};
+    Registry_File old_file = {0};
+    Registry_File new_file = {0};
+    Registry_File patch = {0};
+    State state = {0};
+
+    const char* old_path = temp_sprintf("%s.old.reg", program);
+    const char* new_path = temp_sprintf("%s.new.reg", program);
+    const char* patch_path = temp_sprintf("%s.patch.reg", program);
+    if (!write_entire_file(old_path, diff_case->old_file, strlen(diff_case->old_file))) return_defer(false);
+    if (!write_entire_file(new_path, diff_case->new_file, strlen(diff_case->new_file))) return_defer(false);
+    cmd_append(&cmd, REGDIFF_PATH, old_path, new_path, "-o", patch_path);
+    if (!cmd_run_sync_and_reset(&cmd)) return_defer(false);
+
+    if (!reg_file_read(old_path, &old_file)) return_defer(false);
+    if (!reg_file_read(new_path, &new_file)) return_defer(false);
+    if (!reg_file_read(patch_path, &patch)) return_defer(false);
+    for (size_t i = 0; i < old_file.keys.count; ++i) {
+        const Registry_Key* key = &old_file.keys.items[i];
+        if (key->deleted) continue;
+        Registry_Key copy = {.path = key->path};
+        da_append_many(&copy.list, key->list.items, key->list.count);
+        da_append(&state, copy);
+    }
+    import_patch(&state, &patch);
+    if (!check_state(diff_case->name, &state, &new_file)) return_defer(false);
+    nob_log(NOB_INFO, "%s: the patch turns the old file into the new file", diff_case->name);
+
+defer:
+    for (size_t i = 0; i < state.count; ++i) da_free(state.items[i].list);
+    da_free(state);
+    reg_file_free(&old_file);
+    reg_file_free(&new_file);
+    reg_file_free(&patch);
+    cmd_free(cmd);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    const char* program = shift(argv, argc);
+    for (size_t i = 0; i < ARRAY_LEN(cases); ++i) {
+        if (!run_case(program, &cases[i])) return 1;
+        temp_reset();
+    }
+    return 0;
+}